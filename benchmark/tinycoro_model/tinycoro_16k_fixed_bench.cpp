@@ -0,0 +1,62 @@
+#include "coro/coro.hpp"
+
+using namespace coro;
+
+#define BUFFLEN (16 * 1024 + 16)
+
+task<> session(int fd)
+{
+    auto conn = io::net::tcp::tcp_connector(fd);
+    auto buf  = io::fixed_buffer();
+    int  ret  = 0;
+
+    if (buf.valid())
+    {
+        while ((ret = co_await conn.read_fixed(buf, BUFFLEN)) > 0)
+        {
+            ret = co_await conn.write_fixed(buf, ret);
+            if (ret <= 0)
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        // registered pool is used up, fall back to normal buffer
+        std::vector<char> normal_buf(BUFFLEN);
+        while ((ret = co_await conn.read(normal_buf.data(), BUFFLEN)) > 0)
+        {
+            ret = co_await conn.write(normal_buf.data(), ret);
+            if (ret <= 0)
+            {
+                break;
+            }
+        }
+    }
+
+    buf.return_back();
+    ret = co_await conn.close();
+    assert(ret == 0);
+}
+
+task<> server(int port)
+{
+    auto server = io::net::tcp::tcp_server(port);
+    log::info("server start in {}", port);
+    int client_fd;
+    while ((client_fd = co_await server.accept()) > 0)
+    {
+        submit_to_scheduler(session(client_fd));
+    }
+}
+
+int main(int argc, char const* argv[])
+{
+    /* code */
+    scheduler::init();
+
+    submit_to_scheduler(server(8000));
+    scheduler::loop();
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "coro/coro.hpp"
+
+using namespace coro;
+
+task<> session(int fd)
+{
+    auto conn   = io::net::tcp::tcp_connector(fd);
+    auto stream = conn.recv_stream();
+    int  ret    = 0;
+
+    // the frame holds no recv buffer, kernel picks one from the buffer ring when data arrives
+    while (true)
+    {
+        auto buf = co_await stream.next();
+        if (buf.result() == -ENOBUFS)
+        {
+            continue;
+        }
+        if (buf.result() <= 0)
+        {
+            break;
+        }
+        ret = co_await conn.write(buf.data(), buf.result());
+        if (ret <= 0)
+        {
+            break;
+        }
+    }
+
+    co_await stream.cancel();
+    ret = co_await conn.close();
+    assert(ret == 0);
+}
+
+task<> server(int port)
+{
+    auto server = io::net::tcp::tcp_server(port);
+    log::info("server start in {}", port);
+    int client_fd;
+    while ((client_fd = co_await server.accept()) > 0)
+    {
+        submit_to_scheduler(session(client_fd));
+    }
+}
+
+int main(int argc, char const* argv[])
+{
+    /* code */
+    scheduler::init();
+
+    submit_to_scheduler(server(8000));
+    scheduler::loop();
+    return 0;
+}
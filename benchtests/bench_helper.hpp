@@ -1,7 +1,9 @@
 #pragma once
 
+#include <fstream>
 #include <functional>
 #include <queue>
+#include <string>
 #include <thread>
 
 #define loop_add                                                                                                       \
@@ -34,6 +36,37 @@
         ->Arg(para2)                                                                                                   \
         ->Arg(para3)
 
+/**
+ * @brief read the number of read/write syscalls issued by current process from /proc/self/io,
+ * eventfd_read and eventfd_write are counted in
+ *
+ */
+struct syscall_counter
+{
+    size_t syscr{0};
+    size_t syscw{0};
+
+    static auto now() noexcept -> syscall_counter
+    {
+        syscall_counter cnt;
+        std::ifstream   ifs("/proc/self/io");
+        std::string     key;
+        size_t          val;
+        while (ifs >> key >> val)
+        {
+            if (key == "syscr:")
+            {
+                cnt.syscr = val;
+            }
+            else if (key == "syscw:")
+            {
+                cnt.syscw = val;
+            }
+        }
+        return cnt;
+    }
+};
+
 /**
  * @brief a simple thread pool, must submit task before start
  *
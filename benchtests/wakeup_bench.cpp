@@ -0,0 +1,199 @@
+#include <thread>
+#include <vector>
+
+#include "bench_helper.hpp"
+#include "benchmark/benchmark.h"
+#include "coro/coro.hpp"
+
+using namespace coro;
+
+/**
+ * @brief these benchmarks report the read/write syscalls per iteration, engine only writes
+ * eventfd when the target context is going to sleep, so syscw should be much less than
+ * the number of resumed or submitted tasks
+ *
+ */
+
+static auto report_syscall(benchmark::State& state, const syscall_counter& start) noexcept -> void
+{
+    auto end                = syscall_counter::now();
+    state.counters["syscr"] = benchmark::Counter(end.syscr - start.syscr, benchmark::Counter::kAvgIterations);
+    state.counters["syscw"] = benchmark::Counter(end.syscw - start.syscw, benchmark::Counter::kAvgIterations);
+}
+
+/*************************************************************
+ *                    coro_event_fanout                      *
+ *************************************************************/
+
+static task<> fanout_wait(event<>& ev, const int loop_num)
+{
+    co_await ev.wait();
+    loop_add;
+}
+
+static task<> fanout_set(event<>& ev, const int loop_num)
+{
+    loop_add;
+    ev.set();
+    co_return;
+}
+
+// one event::set resumes waiter_num waiters spread over all contexts
+static void coro_event_fanout(benchmark::State& state)
+{
+    auto start = syscall_counter::now();
+    for (auto _ : state)
+    {
+        const int waiter_num = state.range(0);
+        const int loop_num   = 100;
+
+        scheduler::init();
+
+        event<> ev;
+        for (int i = 0; i < waiter_num; i++)
+        {
+            submit_to_scheduler(fanout_wait(ev, loop_num));
+        }
+        submit_to_scheduler(fanout_set(ev, loop_num));
+
+        scheduler::loop();
+    }
+    report_syscall(state, start);
+}
+
+CORO_BENCHMARK3(coro_event_fanout, 100, 1000, 10000);
+
+/*************************************************************
+ *                    coro_cross_submit                      *
+ *************************************************************/
+
+static task<> cross_work(const int loop_num)
+{
+    loop_add;
+    co_return;
+}
+
+static task<> cross_submit(const int task_num, const int loop_num)
+{
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(cross_work(loop_num));
+    }
+    co_return;
+}
+
+// working threads keep submitting tasks to each other while they are busy
+static void coro_cross_submit(benchmark::State& state)
+{
+    auto start = syscall_counter::now();
+    for (auto _ : state)
+    {
+        const int task_num   = state.range(0);
+        const int thread_num = std::thread::hardware_concurrency();
+        const int loop_num   = 1000;
+
+        scheduler::init();
+
+        for (int i = 0; i < thread_num; i++)
+        {
+            submit_to_scheduler(cross_submit(task_num / thread_num, loop_num));
+        }
+
+        scheduler::loop();
+    }
+    report_syscall(state, start);
+}
+
+CORO_BENCHMARK2(coro_cross_submit, 1000, 10000);
+
+/*************************************************************
+ *                      coro_spawn                           *
+ *************************************************************/
+
+static task<> spawn_single(const int task_num, const int loop_num)
+{
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(cross_work(loop_num));
+    }
+    co_return;
+}
+
+static task<> spawn_batch(const int task_num, const int loop_num)
+{
+    std::vector<task<>> tasks;
+    tasks.reserve(task_num);
+    for (int i = 0; i < task_num; i++)
+    {
+        tasks.push_back(cross_work(loop_num));
+    }
+    scheduler::submit_batch(tasks);
+    co_return;
+}
+
+// one task spawns task_num subtasks one by one
+static void coro_spawn_single(benchmark::State& state)
+{
+    auto start = syscall_counter::now();
+    for (auto _ : state)
+    {
+        scheduler::init();
+        submit_to_scheduler(spawn_single(state.range(0), 100));
+        scheduler::loop();
+    }
+    report_syscall(state, start);
+}
+
+CORO_BENCHMARK2(coro_spawn_single, 1000, 10000);
+
+// one task spawns task_num subtasks by scheduler::submit_batch
+static void coro_spawn_batch(benchmark::State& state)
+{
+    auto start = syscall_counter::now();
+    for (auto _ : state)
+    {
+        scheduler::init();
+        submit_to_scheduler(spawn_batch(state.range(0), 100));
+        scheduler::loop();
+    }
+    report_syscall(state, start);
+}
+
+CORO_BENCHMARK2(coro_spawn_batch, 1000, 10000);
+
+/*************************************************************
+ *                      coro_nop_io                          *
+ *************************************************************/
+
+static task<> nop_io(const int io_num)
+{
+    for (int i = 0; i < io_num; i++)
+    {
+        co_await io::noop_awaiter{};
+    }
+}
+
+// tasks keep issuing nop io, each completion resumes the awaiting coroutine,
+// see config::kInlineCqeResume
+static void coro_nop_io(benchmark::State& state)
+{
+    auto start = syscall_counter::now();
+    for (auto _ : state)
+    {
+        const int task_num = state.range(0);
+
+        scheduler::init();
+
+        for (int i = 0; i < task_num; i++)
+        {
+            submit_to_scheduler(nop_io(100));
+        }
+
+        scheduler::loop();
+    }
+    report_syscall(state, start);
+}
+
+CORO_BENCHMARK2(coro_nop_io, 100, 1000);
+
+BENCHMARK_MAIN();
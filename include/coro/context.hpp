@@ -12,12 +12,17 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <thread>
+#include <vector>
 
 #include "config.h"
+#include "coro/concepts/range_of.hpp"
 #include "coro/engine.hpp"
 #include "coro/meta_info.hpp"
 #include "coro/task.hpp"
+#include "coro/utils.hpp"
 
 namespace coro
 {
@@ -43,16 +48,55 @@ using std::make_unique;
 using std::memory_order_acq_rel;
 using std::memory_order_acquire;
 using std::memory_order_relaxed;
+using std::stop_source;
 using std::stop_token;
 using std::unique_ptr;
 
 using detail::ginfo;
 using detail::linfo;
 
-using engine = detail::engine;
+using engine        = detail::engine;
+using task_priority = detail::task_priority;
 
 class scheduler;
 
+namespace detail
+{
+/**
+ * @brief detach all tasks in range and return their handles, the handles are owned by engine later
+ *
+ * @param tasks
+ * @return std::vector<std::coroutine_handle<>>
+ */
+template<concepts::range_of<task<void>> range_type>
+inline auto detach_tasks(range_type&& tasks) noexcept -> std::vector<std::coroutine_handle<>>
+{
+    std::vector<std::coroutine_handle<>> handles;
+    if constexpr (std::ranges::sized_range<range_type>)
+    {
+        handles.reserve(std::ranges::size(tasks));
+    }
+    for (auto& task : tasks)
+    {
+        handles.push_back(task.handle());
+        task.detach();
+    }
+    return handles;
+}
+}; // namespace detail
+
+/**
+ * @brief runtime counters of one context and its engine, see detail::engine_stats
+ *
+ */
+struct context_stats : public detail::engine_stats
+{
+    ctx_id id{0};
+    size_t num_wait_task{0};   // registered waits such as event or mutex waiters now
+    size_t num_steal{0};       // successful steals from other contexts
+    size_t max_task_queued{0}; // max tasks seen by one process_work round
+};
+
 /**
  * @brief Each context own one engine, it's the core part of tinycoro,
  * which can process computation task and io task
@@ -60,7 +104,11 @@ class scheduler;
  */
 class context
 {
+    friend class scheduler;
+
     using stop_cb=std::function<void()>;
+    using steal_cb=std::function<bool()>;
+    using migrate_cb=std::function<void(std::coroutine_handle<>, task_priority)>;
 public:
     context() noexcept;
     ~context() noexcept                = default;
@@ -85,27 +133,121 @@ public:
      */
     [[CORO_TEST_USED(lab2b)]] auto notify_stop() noexcept -> void;
 
+    /**
+     * @brief stop work thread without waiting its tasks and io to finish, the queued tasks
+     * are dropped and counted by num_cancelled_task, pending io are cancelled and counted by
+     * num_cancelled_io together with waits still registered
+     *
+     * @note the task running now is not interrupted, work thread stops after it suspends or finishes,
+     * coroutines awaiting cancelled io resume with -ECANCELED before work thread stops
+     */
+    auto force_stop() noexcept -> void;
+
+    /**
+     * @brief stop work thread after its queued tasks are handed to migrate callback,
+     * io and waits still pending are finished in this context before work thread stops
+     *
+     * @note try_submit_task and try_submit_batch are rejected once this is called, tasks they
+     * pushed before are migrated, submit_task still works for io callbacks and waits of this context
+     */
+    auto retire() noexcept -> void;
+
+    /**
+     * @brief return if work thread is not running, which means it has not started
+     * or it has finished its loop and deinit
+     *
+     * @return true
+     * @return false
+     */
+    inline auto is_finished() noexcept -> bool { return m_finished.load(memory_order_acquire); }
+
+    /**
+     * @brief return the number of queued tasks dropped by force_stop
+     *
+     * @note valid after work thread finished
+     */
+    inline auto num_cancelled_task() noexcept -> size_t { return m_num_cancelled_task; }
+
+    /**
+     * @brief return the number of io and waits still pending when force_stop takes effect
+     *
+     * @note valid after work thread finished
+     */
+    inline auto num_cancelled_io() noexcept -> size_t { return m_num_cancelled_io; }
+
     /**
      * @brief wait work thread stop
      *
      */
-    inline auto join() noexcept -> void { m_job->join(); }
+    inline auto join() noexcept -> void
+    {
+        if (m_job && m_job->joinable())
+        {
+            m_job->join();
+        }
+    }
 
-    inline auto submit_task(task<void>&& task) noexcept -> void
+    inline auto submit_task(task<void>&& task, task_priority prio = task_priority::normal) noexcept -> void
     {
         auto handle = task.handle();
         task.detach();
-        this->submit_task(handle);
+        this->submit_task(handle, prio);
     }
 
-    inline auto submit_task(task<void>& task) noexcept -> void { submit_task(task.handle()); }
+    inline auto submit_task(task<void>& task, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        submit_task(task.handle(), prio);
+    }
 
     /**
      * @brief submit one task handle to context
      *
      * @param handle
+     * @param prio priority class of task
      */
-    [[CORO_TEST_USED(lab2b)]] auto submit_task(std::coroutine_handle<> handle) noexcept -> void;
+    [[CORO_TEST_USED(lab2b)]] auto submit_task(
+        std::coroutine_handle<> handle, task_priority prio = task_priority::normal) noexcept -> void;
+
+    /**
+     * @brief submit tasks in batch, tasks in range are detached and owned by context
+     *
+     * @param tasks
+     * @param prio priority class of all tasks
+     */
+    template<concepts::range_of<task<void>> range_type>
+    inline auto submit_batch(range_type&& tasks, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        auto handles = detail::detach_tasks(tasks);
+        submit_batch(std::span<const std::coroutine_handle<>>(handles), prio);
+    }
+
+    /**
+     * @brief submit task handles in batch, context is woken up at most once
+     *
+     * @param handles
+     * @param prio priority class of all tasks
+     */
+    auto submit_batch(
+        std::span<const std::coroutine_handle<>> handles, task_priority prio = task_priority::normal) noexcept -> void;
+
+    /**
+     * @brief submit one task handle unless context has begun to retire, used by scheduler dispatch,
+     * a handle accepted here is either run by this context or migrated when it retires
+     *
+     * @param handle
+     * @param prio priority class of task
+     * @return true if context accepts the handle, false if caller should choose another context
+     */
+    auto try_submit_task(std::coroutine_handle<> handle, task_priority prio) noexcept -> bool;
+
+    /**
+     * @brief submit task handles in batch unless context has begun to retire, see try_submit_task
+     *
+     * @param handles
+     * @param prio priority class of all tasks
+     * @return true if context accepts all handles, false if none of them is accepted
+     */
+    auto try_submit_batch(std::span<const std::coroutine_handle<>> handles, task_priority prio) noexcept -> bool;
 
     /**
      * @brief get context unique id
@@ -130,6 +272,13 @@ public:
 
     inline auto get_engine() noexcept -> engine& { return m_engine; }
 
+    /**
+     * @brief return the scheduler which created this context, nullptr if context is created directly
+     *
+     * @return scheduler*
+     */
+    inline auto get_scheduler() noexcept -> scheduler* { return m_sched; }
+
     /**
      * @brief main logic of work thread
      *
@@ -144,15 +293,98 @@ public:
 
     auto set_stop_cb(stop_cb cb) noexcept -> void;
 
+    /**
+     * @brief pin the working thread to cpus, the thread is pinned before engine init,
+     * so uring and memory first touched by the thread are allocated on the local numa node
+     *
+     * @note must be called before start, empty cpus means no affinity
+     *
+     * @param cpus
+     */
+    auto set_cpu_affinity(utils::cpu_list cpus) noexcept -> void;
+
+    inline auto get_cpu_affinity() noexcept -> const utils::cpu_list& { return m_cpus; }
+
+    /**
+     * @brief set the callback which is called to steal tasks from other
+     * contexts when this context has no task to run
+     *
+     * @param cb return true if any task is stolen
+     */
+    auto set_steal_cb(steal_cb cb) noexcept -> void;
+
+    /**
+     * @brief return the runtime counters of context and its engine
+     *
+     * @note this is thread-safe
+     *
+     * @return context_stats
+     */
+    auto get_stats() noexcept -> context_stats;
+
+    /**
+     * @brief set the callback which takes the queued tasks of this context when it retires
+     *
+     * @param cb
+     */
+    auto set_migrate_cb(migrate_cb cb) noexcept -> void;
+
 private:
     CORO_ALIGN engine   m_engine;
     unique_ptr<jthread> m_job;
     ctx_id              m_id;
+    scheduler*          m_sched{nullptr}; // set by scheduler when it creates this context
 
     atomic<size_t> m_num_wait_task{0}; ///< 等待任务计数器（所有 context 共享）
 
     // TODO[lab2b]: Add more member variables if you need
     stop_cb m_stop_cb;
+    steal_cb m_steal_cb;
+    migrate_cb m_migrate_cb;
+
+    // cpus which the working thread is pinned to, empty means no affinity
+    utils::cpu_list m_cpus;
+
+    // created before the working thread starts, so stop can be requested
+    // even if the thread runs out of work before m_job is assigned
+    stop_source m_stop_src;
+
+    // set by force_stop, work thread leaves its loop at once and drops queued tasks
+    atomic<bool> m_force_stop{false};
+
+    // set by retire, work thread hands its queued tasks to m_migrate_cb and then stops
+    atomic<bool> m_retire{false};
+
+    // handshake between retire and try_submit: submitters count themselves in m_num_submitting
+    // before checking m_accepting, work thread waits the count drop to 0 after retire clears
+    // m_accepting, so every accepted push lands before the queued tasks are migrated
+    alignas(config::kCacheLineSize) atomic<bool> m_accepting{true};
+    atomic<size_t> m_num_submitting{0};
+
+    // false from start until deinit finishes, stop requests check it under m_exit_mtx so they never
+    // wake an engine during deinit, the eventfd lives as long as engine, so waking before init is harmless
+    atomic<bool> m_finished{true};
+    std::mutex   m_exit_mtx;
+
+    /**
+     * @brief cancel all io and run the coroutines resumed by them until engine has no io and task,
+     * io issued by these coroutines are cancelled again, gives up after config::kMaxCancelRound rounds
+     *
+     */
+    auto cancel_io() noexcept -> void;
+
+    /**
+     * @brief wait submitters which passed the m_accepting check, then hand queued tasks to m_migrate_cb
+     *
+     */
+    auto migrate_tasks() noexcept -> void;
+
+    size_t m_num_cancelled_task{0};
+    size_t m_num_cancelled_io{0};
+
+    // runtime counters only written by work thread, read by get_stats
+    alignas(config::kCacheLineSize) atomic<size_t> m_num_steal{0};
+    atomic<size_t> m_max_task_queued{0};
 };
 
 inline context& local_context() noexcept
@@ -160,19 +392,30 @@ inline context& local_context() noexcept
     return *linfo.ctx;
 }
 
-inline void submit_to_context(task<void>&& task) noexcept
+inline void submit_to_context(task<void>&& task, task_priority prio = task_priority::normal) noexcept
 {
-    local_context().submit_task(std::move(task));
+    local_context().submit_task(std::move(task), prio);
 }
 
-inline void submit_to_context(task<void>& task) noexcept
+inline void submit_to_context(task<void>& task, task_priority prio = task_priority::normal) noexcept
 {
-    local_context().submit_task(task.handle());
+    local_context().submit_task(task.handle(), prio);
 }
 
+inline void submit_to_context(std::coroutine_handle<> handle, task_priority prio) noexcept
+{
+    local_context().submit_task(handle, prio);
+}
+
+/**
+ * @brief requeue the suspended coroutine handle to local context with the priority class it was
+ * last submitted with, used by io callbacks so a high priority coroutine stays high after io
+ *
+ * @param handle must be the handle of a task
+ */
 inline void submit_to_context(std::coroutine_handle<> handle) noexcept
 {
-    local_context().submit_task(handle);
+    local_context().submit_task(handle, detail::get_priority(handle));
 }
 
 }; // namespace coro
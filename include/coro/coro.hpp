@@ -9,7 +9,10 @@
 #include "coro/comp/when_all.hpp"
 #include "coro/io/net/tcp/tcp.hpp"
 #include "coro/log.hpp"
+#include "coro/offload.hpp"
 #include "coro/parallel/parallel.hpp"
 #include "coro/scheduler.hpp"
+#include "coro/switch_to.hpp"
 #include "coro/timer.hpp"
-#include "coro/utils.hpp"
\ No newline at end of file
+#include "coro/utils.hpp"
+#include "coro/yield.hpp"
\ No newline at end of file
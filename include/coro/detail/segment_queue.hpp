@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+#include "config.h"
+#include "coro/attribute.hpp"
+#include "coro/spinlock.hpp"
+
+namespace coro::detail
+{
+/**
+ * @brief unbounded mpmc fifo queue made of fixed size segments, engine uses it as the overflow
+ * of its bounded task queue, so a burst of submissions never blocks the submitter or drops tasks
+ *
+ * @note all operations are protected by a spinlock, overflow is expected to be the slow path
+ *
+ * @tparam T storage_type
+ * @tparam SegSize element number of one segment
+ */
+template<typename T, size_t SegSize>
+class segment_queue
+{
+    struct segment
+    {
+        T        data[SegSize];
+        size_t   head{0};
+        size_t   tail{0};
+        segment* next{nullptr};
+    };
+
+public:
+    segment_queue() noexcept = default;
+
+    ~segment_queue() noexcept
+    {
+        clear();
+        delete m_spare;
+    }
+
+    CORO_NO_COPY_MOVE(segment_queue);
+
+    auto push(T value) noexcept -> void
+    {
+        std::lock_guard<spinlock> lk(m_lock);
+        push_unlocked(value);
+    }
+
+    /**
+     * @brief push num elements starting from values under one lock
+     *
+     * @param values
+     * @param num
+     */
+    auto push_batch(const T* values, size_t num) noexcept -> void
+    {
+        std::lock_guard<spinlock> lk(m_lock);
+        for (size_t i = 0; i < num; i++)
+        {
+            push_unlocked(values[i]);
+        }
+    }
+
+    auto try_pop(T& value) noexcept -> bool
+    {
+        if (was_empty())
+        {
+            return false;
+        }
+
+        std::lock_guard<spinlock> lk(m_lock);
+        if (m_head == nullptr || m_head->head == m_head->tail)
+        {
+            return false;
+        }
+        value = m_head->data[m_head->head++];
+        m_size.store(m_size.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+
+        if (m_head->head == m_head->tail)
+        {
+            // the last segment is reused in place, others are released
+            if (m_head == m_tail)
+            {
+                m_head->head = m_head->tail = 0;
+            }
+            else
+            {
+                auto seg = m_head;
+                m_head   = seg->next;
+                free_segment(seg);
+            }
+        }
+        return true;
+    }
+
+    inline auto was_size() const noexcept -> size_t { return m_size.load(std::memory_order_relaxed); }
+
+    inline auto was_empty() const noexcept -> bool { return was_size() == 0; }
+
+    /**
+     * @brief return the total number of pushed elements since queue created
+     *
+     * @return size_t
+     */
+    auto num_push() noexcept -> size_t
+    {
+        std::lock_guard<spinlock> lk(m_lock);
+        return m_num_push;
+    }
+
+    /**
+     * @brief return the max number of elements queue has ever held
+     *
+     * @return size_t
+     */
+    auto max_size() noexcept -> size_t
+    {
+        std::lock_guard<spinlock> lk(m_lock);
+        return m_max_size;
+    }
+
+    /**
+     * @brief drop all elements and reset metrics
+     *
+     */
+    auto clear() noexcept -> void
+    {
+        std::lock_guard<spinlock> lk(m_lock);
+        while (m_head != nullptr)
+        {
+            auto seg = m_head;
+            m_head   = seg->next;
+            delete seg;
+        }
+        m_tail = nullptr;
+        m_size.store(0, std::memory_order_release);
+        m_num_push = 0;
+        m_max_size = 0;
+    }
+
+private:
+    inline auto push_unlocked(T value) noexcept -> void
+    {
+        if (m_tail == nullptr || m_tail->tail == SegSize)
+        {
+            auto seg = new_segment();
+            if (m_tail == nullptr)
+            {
+                m_head = seg;
+            }
+            else
+            {
+                m_tail->next = seg;
+            }
+            m_tail = seg;
+        }
+        m_tail->data[m_tail->tail++] = value;
+
+        auto size = m_size.load(std::memory_order_relaxed) + 1;
+        m_size.store(size, std::memory_order_release);
+        m_num_push++;
+        m_max_size = size > m_max_size ? size : m_max_size;
+    }
+
+    inline auto new_segment() noexcept -> segment*
+    {
+        if (m_spare != nullptr)
+        {
+            return std::exchange(m_spare, nullptr);
+        }
+        return new segment;
+    }
+
+    inline auto free_segment(segment* seg) noexcept -> void
+    {
+        if (m_spare == nullptr)
+        {
+            seg->head = seg->tail = 0;
+            seg->next             = nullptr;
+            m_spare               = seg;
+            return;
+        }
+        delete seg;
+    }
+
+private:
+    spinlock            m_lock;
+    segment*            m_head{nullptr};
+    segment*            m_tail{nullptr};
+    segment*            m_spare{nullptr}; // keep one free segment to avoid malloc churn around segment boundary
+    std::atomic<size_t> m_size{0};
+    size_t              m_num_push{0};
+    size_t              m_max_size{0};
+};
+
+}; // namespace coro::detail
@@ -6,7 +6,7 @@
 namespace coro::detail
 {
 
-// TODO: Add lifo and fifo strategy support
+// schedule strategy of engine local task buffer, see config::kScheduleStrategy
 enum class schedule_strategy : uint8_t
 {
     fifo, // default
@@ -14,9 +14,39 @@ enum class schedule_strategy : uint8_t
     none
 };
 
+// how engine waits for io completion and task wakeup, see config::kPollStrategy
+enum class poll_strategy : uint8_t
+{
+    eventfd, // default
+    submit_and_wait,
+    none
+};
+
+// priority class of task, tasks of higher class run ahead of lower classes queued in the same engine
+enum class task_priority : uint8_t
+{
+    high,   // latency critical work, such as request continuations
+    normal, // default
+    low,    // background bulk work, such as compaction or log flushing
+    none
+};
+
 enum class dispatch_strategy : uint8_t
 {
     round_robin,
+    work_stealing,
+    least_loaded,
+    power_of_two,
+    affinity_hash,
+    none
+};
+
+// how scheduler pins the working thread of context to cpus, see scheduler::init
+enum class affinity_strategy : uint8_t
+{
+    unbound,   // default, working threads are scheduled by kernel freely
+    core,      // context i is pinned to the i-th allowed cpu
+    numa_node, // contexts are evenly grouped by numa node, each context can run on all cpus of its node
     none
 };
 
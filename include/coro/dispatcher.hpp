@@ -1,7 +1,9 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <memory>
+#include <thread>
 #include <vector>
 
 #include "coro/context.hpp"
@@ -43,6 +45,15 @@ public:
      */
     void init([[CORO_MAYBE_UNUSED]] const size_t ctx_cnt, [[CORO_MAYBE_UNUSED]] ctx_container* ctxs) noexcept {}
 
+    /**
+     * @brief change the number of contexts to dispatch at runtime, contexts [0, ctx_cnt) are chosen
+     *
+     * @note dispatch may run concurrently, it sees either the old or the new value
+     *
+     * @param ctx_cnt
+     */
+    void resize([[CORO_MAYBE_UNUSED]] const size_t ctx_cnt) noexcept {}
+
     /**
      * @brief Choose one context to schedule by specific strategy.
      * The impl needs to ensure thread safety.
@@ -67,11 +78,194 @@ public:
         m_cur     = 0;
     }
 
-    auto dispatch() noexcept -> size_t { return m_cur.fetch_add(1, std::memory_order_acq_rel) % m_ctx_cnt; }
+    void resize(size_t ctx_cnt) noexcept { m_ctx_cnt.store(ctx_cnt, std::memory_order_relaxed); }
+
+    auto dispatch() noexcept -> size_t
+    {
+        return m_cur.fetch_add(1, std::memory_order_acq_rel) % m_ctx_cnt.load(std::memory_order_relaxed);
+    }
 
 private:
-    size_t              m_ctx_cnt;
+    std::atomic<size_t> m_ctx_cnt{1};
     std::atomic<size_t> m_cur{0};
 };
 
+/**
+ * @brief work stealing places new tasks by round robin, the load balance is done
+ * later by idle contexts which steal ready tasks from busy contexts
+ *
+ * @note see scheduler::steal_impl for the steal logic
+ */
+template<>
+class dispatcher<dispatch_strategy::work_stealing> : public dispatcher<dispatch_strategy::round_robin>
+{
+};
+
+/**
+ * @brief per-thread state shared by load-aware dispatchers, each submitter thread walks its own
+ * cursor and random sequence, so dispatch doesn't bounce a shared cache line between cores
+ *
+ */
+class dispatch_cursor
+{
+public:
+    /**
+     * @brief return the next value of thread local cursor, the start value differs among threads
+     *
+     * @return size_t
+     */
+    static inline auto next() noexcept -> size_t { return t_cursor++; }
+
+    /**
+     * @brief return thread local pseudo random number by xorshift64
+     *
+     * @return uint64_t
+     */
+    static inline auto random() noexcept -> uint64_t
+    {
+        t_seed ^= t_seed << 13;
+        t_seed ^= t_seed >> 7;
+        t_seed ^= t_seed << 17;
+        return t_seed;
+    }
+
+    /**
+     * @brief mix bits of key so that adjacent keys are spread among contexts
+     *
+     * @param key
+     * @return uint64_t
+     */
+    static inline auto mix(uint64_t key) noexcept -> uint64_t
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+private:
+    static inline auto thread_seed() noexcept -> uint64_t
+    {
+        return mix(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1;
+    }
+
+    inline static thread_local uint64_t t_seed{thread_seed()};
+    inline static thread_local size_t   t_cursor{t_seed};
+};
+
+/**
+ * @brief base of load-aware dispatchers, the load of context is estimated by engine::num_task_load
+ *
+ */
+class load_dispatcher_base
+{
+public:
+    void init(size_t ctx_cnt, ctx_container* ctxs) noexcept
+    {
+        m_ctx_cnt = ctx_cnt;
+        m_ctxs    = ctxs;
+    }
+
+    void resize(size_t ctx_cnt) noexcept { m_ctx_cnt.store(ctx_cnt, std::memory_order_relaxed); }
+
+protected:
+    inline auto load(size_t id) noexcept -> size_t { return (*m_ctxs)[id]->get_engine().num_task_load(); }
+
+    inline auto ctx_cnt() noexcept -> size_t { return m_ctx_cnt.load(std::memory_order_relaxed); }
+
+    std::atomic<size_t> m_ctx_cnt{0};
+    ctx_container*      m_ctxs{nullptr};
+};
+
+/**
+ * @brief least loaded scans all contexts and choose the one with the least load,
+ * the scan starts from thread local cursor so ties are spread among contexts
+ *
+ */
+template<>
+class dispatcher<dispatch_strategy::least_loaded> : public load_dispatcher_base
+{
+public:
+    auto dispatch() noexcept -> size_t
+    {
+        auto cnt      = ctx_cnt();
+        auto start    = dispatch_cursor::next() % cnt;
+        auto best     = start;
+        auto min_load = load(start);
+        for (size_t i = 1; i < cnt && min_load > 0; i++)
+        {
+            auto id  = (start + i) % cnt;
+            auto num = load(id);
+            if (num < min_load)
+            {
+                min_load = num;
+                best     = id;
+            }
+        }
+        return best;
+    }
+};
+
+/**
+ * @brief power of two choices picks two different contexts randomly and choose the less loaded one,
+ * it costs constant time and is close to least loaded in practice
+ *
+ */
+template<>
+class dispatcher<dispatch_strategy::power_of_two> : public load_dispatcher_base
+{
+public:
+    auto dispatch() noexcept -> size_t
+    {
+        auto cnt = ctx_cnt();
+        if (cnt == 1)
+        {
+            return 0;
+        }
+        auto rnd    = dispatch_cursor::random();
+        auto first  = rnd % cnt;
+        auto second = (rnd >> 32) % (cnt - 1);
+        second += second >= first ? 1 : 0;
+        return load(first) <= load(second) ? first : second;
+    }
+};
+
+/**
+ * @brief affinity hash dispatches task with key by the hash of key, so tasks of the same key,
+ * such as one session, always run in the same context, tasks without key are dispatched
+ * by thread local round robin
+ *
+ */
+template<>
+class dispatcher<dispatch_strategy::affinity_hash> : public load_dispatcher_base
+{
+public:
+    auto dispatch() noexcept -> size_t { return dispatch_cursor::next() % ctx_cnt(); }
+
+    // keys are remapped when the number of contexts changes
+    auto dispatch(uint64_t key) noexcept -> size_t { return dispatch_cursor::mix(key) % ctx_cnt(); }
+};
+
+/**
+ * @brief dispatch by key if the strategy supports key, otherwise key is ignored
+ *
+ * @param dp dispatcher
+ * @param key
+ * @return size_t
+ */
+template<typename dispatcher_type>
+inline auto dispatch_by_key(dispatcher_type& dp, uint64_t key) noexcept -> size_t
+{
+    if constexpr (requires { dp.dispatch(key); })
+    {
+        return dp.dispatch(key);
+    }
+    else
+    {
+        return dp.dispatch();
+    }
+}
+
 }; // namespace coro::detail
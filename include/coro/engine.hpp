@@ -12,13 +12,16 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <coroutine>
 #include <functional>
 #include <queue>
+#include <span>
 
 #include "config.h"
 #include "coro/atomic_que.hpp"
 #include "coro/attribute.hpp"
+#include "coro/detail/segment_queue.hpp"
 #include "coro/meta_info.hpp"
 #include "coro/uring_proxy.hpp"
 
@@ -76,6 +79,22 @@ template<typename T>
 // multi producer and multi consumer queue
 using mpmc_queue = AtomicQueue<T>;
 
+/**
+ * @brief runtime counters of one engine, counters are accumulated since engine construction
+ * and not reset by deinit, so readers can take the difference of two snapshots
+ *
+ */
+struct engine_stats
+{
+    size_t   num_task_exec{0};      // tasks resumed by exec_one_task
+    size_t   num_cqe{0};            // io cqes dispatched to io callbacks, internal wakeup and cancel cqes are excluded
+    size_t   num_wakeup{0};         // times owner thread returned from blocking wait
+    uint64_t idle_time{0};          // nanoseconds blocked in waiting io or task
+    size_t   num_io_running{0};     // io submitted to kernel but not finished now
+    size_t   num_io_wait_submit{0}; // io prepared but not submitted now
+    size_t   num_task_queued{0};    // tasks queued in engine now, local buffer part is published once per poll
+};
+
 class engine
 {
     friend class ::coro::context;
@@ -128,8 +147,40 @@ public:
      * @brief submit one task handle to engine
      *
      * @param handle
+     * @param prio priority class of task, high priority tasks run ahead of normal and low ones
+     */
+    [[CORO_TEST_USED(lab2a)]] auto submit_task(
+        coroutine_handle<> handle, task_priority prio = task_priority::normal) noexcept -> void;
+
+    /**
+     * @brief submit task handles in batch, at most one eventfd write is issued for the whole batch
+     *
+     * @param handles
+     * @param prio priority class of all tasks in this batch
      */
-    [[CORO_TEST_USED(lab2a)]] auto submit_task(coroutine_handle<> handle) noexcept -> void;
+    auto submit_batch(std::span<const coroutine_handle<>> handles, task_priority prio = task_priority::normal) noexcept
+        -> void;
+
+    /**
+     * @brief submit one task handle which must run on this engine, unlike submit_task the handle
+     * is never stolen by other engines nor migrated when context retires
+     *
+     * @note this is thread-safe
+     *
+     * @param handle
+     * @param prio priority class recorded in the promise, the handle runs ahead of normal tasks
+     */
+    auto submit_pinned_task(coroutine_handle<> handle, task_priority prio = task_priority::normal) noexcept -> void;
+
+    /**
+     * @brief requeue the task handle which gives up cpu by yield, it runs after the tasks
+     * already queued in this engine, no eventfd write is issued
+     *
+     * @note must be called by the thread which owns this engine
+     *
+     * @param handle
+     */
+    auto yield_task(coroutine_handle<> handle) noexcept -> void;
 
     /**
      * @brief this will call schedule() to fetch one task handle and run it
@@ -170,6 +221,81 @@ public:
      */
     [[CORO_TEST_USED(lab2a)]] auto empty_io() noexcept -> bool;
 
+    /**
+     * @brief return the number of io to be submitted and io running in uring
+     *
+     * @return size_t
+     */
+    inline auto num_io() noexcept -> size_t { return m_num_io_wait_submit + m_num_io_running; }
+
+    /**
+     * @brief fetch all queued task handles and pass them to fn with their priority class,
+     * high priority tasks first, then normal and low ones
+     *
+     * @note must be called by the thread which owns this engine, used to migrate tasks
+     * off a retiring context
+     *
+     * @param fn
+     * @return size_t the number of fetched task handles
+     */
+    auto drain_tasks(const std::function<void(coroutine_handle<>, task_priority)>& fn) noexcept -> size_t;
+
+    /**
+     * @brief return the total nanoseconds engine has blocked to wait io or task, include the
+     * ongoing block, it is not reset by deinit, so readers can take the difference of two calls
+     *
+     * @note this is thread-safe
+     *
+     * @return uint64_t
+     */
+    inline auto idle_time() noexcept -> uint64_t
+    {
+        auto since = m_idle_since.load(std::memory_order_relaxed);
+        auto total = m_idle_time.load(std::memory_order_relaxed);
+        auto now   = steady_now_ns();
+        return since == 0 || since > now ? total : total + (now - since);
+    }
+
+    /**
+     * @brief return the runtime counters of engine
+     *
+     * @note this is thread-safe, counters are read one by one, so they may be slightly inconsistent
+     * with each other when the engine is running
+     *
+     * @return engine_stats
+     */
+    auto get_stats() noexcept -> engine_stats;
+
+    /**
+     * @brief return nanoseconds of steady clock, used by idle time
+     *
+     * @return uint64_t
+     */
+    static inline auto steady_now_ns() noexcept -> uint64_t
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /**
+     * @brief fetch all queued task handles and drop them, detached tasks are destroyed like clean()
+     *
+     * @note must be called by the thread which owns this engine, used by forced shutdown
+     *
+     * @return size_t the number of dropped task handles
+     */
+    auto cancel_all_tasks() noexcept -> size_t;
+
+    /**
+     * @brief prepare one cancel request which matches every io in uring, the cancelled io finish
+     * with -ECANCELED and their callbacks run as usual, the cancel request itself is counted as io
+     *
+     * @note must be called by the thread which owns this engine, used by forced shutdown
+     *
+     */
+    auto cancel_all_io() noexcept -> void;
+
     /**
      * @brief return engine unique id
      *
@@ -189,6 +315,99 @@ public:
     auto do_io_submit() noexcept -> void;
     auto wake_up(uint64_t val)noexcept->void;
 
+    /**
+     * @brief steal half of victim's queued task handles but no more than max_num,
+     * the stolen handles are submitted to this engine
+     *
+     * @note victim may be owned by another thread, but this engine must be owned by caller
+     *
+     * @param victim
+     * @param max_num
+     * @return size_t the number of stolen task handles
+     */
+    auto steal_from(engine& victim, size_t max_num) noexcept -> size_t;
+
+    /**
+     * @brief return the number of task handles which can be stolen by other engines,
+     * only task handles in shared task queue and overflow queue can be stolen
+     *
+     * @note this is thread-safe
+     *
+     * @return size_t
+     */
+    inline auto num_task_stealable() noexcept -> size_t
+    {
+        return m_task_queue.was_size() + m_overflow_queue.was_size();
+    }
+
+    /**
+     * @brief return the estimated load of engine, include queued tasks and io to be finished,
+     * used by load-aware dispatchers
+     *
+     * @note this is thread-safe, the part only accessed by owner thread, such as local task buffer
+     * and io count, is published once per poll, so it may lag behind a little
+     *
+     * @return size_t
+     */
+    inline auto num_task_load() noexcept -> size_t
+    {
+        return m_local_load.load(std::memory_order_relaxed) + num_task_stealable() + num_prio_task();
+    }
+
+    /**
+     * @brief return the number of task handles in overflow queue
+     *
+     * @return size_t
+     */
+    inline auto num_task_overflow() noexcept -> size_t { return m_overflow_queue.was_size(); }
+
+    /**
+     * @brief return how many task handles have been pushed into overflow queue since engine init
+     *
+     * @return size_t
+     */
+    inline auto num_overflow_push() noexcept -> size_t { return m_overflow_queue.num_push(); }
+
+    /**
+     * @brief return the max number of task handles overflow queue has ever held since engine init
+     *
+     * @return size_t
+     */
+    inline auto max_task_overflow() noexcept -> size_t { return m_overflow_queue.max_size(); }
+
+    /**
+     * @brief return the number of tasks of priority class prio which have been
+     * fetched by schedule() since engine init
+     *
+     * @param prio
+     * @return size_t
+     */
+    inline auto num_task_run(task_priority prio) noexcept -> size_t
+    {
+        return m_num_task_run[static_cast<size_t>(prio)];
+    }
+
+    /**
+     * @brief return the number of coroutines resumed from cqe ready ring since engine init
+     *
+     * @return size_t
+     */
+    inline auto num_inline_resume() noexcept -> size_t { return m_num_inline_resume; }
+
+    /**
+     * @brief return the number of busy polls which found io or task before timeout
+     *
+     * @return size_t
+     */
+    inline auto num_spin_hit() noexcept -> size_t { return m_num_spin_hit; }
+
+    /**
+     * @brief return the number of busy polls which timeout and then engine went to sleep
+     *
+     * @return size_t
+     */
+    inline auto num_spin_sleep() noexcept -> size_t { return m_num_spin_sleep; }
+
     /**
      * @brief eventfd 事件掩码常量（用于判断事件类型）
      *
@@ -214,6 +433,209 @@ public:
     static constexpr uint64_t task_flag = (((uint64_t)1) << 44); ///< 任务提交时写入此值
     static constexpr uint64_t io_flag   = (((uint64_t)1) << 24); ///< IO 事件时写入此值
 
+private:
+    /**
+     * @brief push one task handle into shared task queue, if the queue is full or overflow queue
+     * is not empty, push it into overflow queue to keep order
+     *
+     * @note this is thread-safe
+     *
+     * @param handle
+     */
+    auto push_shared_task(coroutine_handle<> handle) noexcept -> void;
+
+    /**
+     * @brief fetch one task handle from shared task queue, then overflow queue
+     *
+     * @note this is thread-safe
+     *
+     * @param handle
+     * @return true if fetch successfully
+     */
+    auto pop_shared_task(coroutine_handle<>& handle) noexcept -> bool;
+
+    /**
+     * @brief return if shared task queue or overflow queue has task handle
+     *
+     * @note this is thread-safe
+     */
+    inline auto has_shared_task() noexcept -> bool
+    {
+        return !m_task_queue.was_empty() || !m_overflow_queue.was_empty() || num_prio_task() > 0 ||
+               !m_pinned_queue.was_empty();
+    }
+
+    /**
+     * @brief return the number of task handles in high and low priority queues
+     *
+     * @note this is thread-safe
+     */
+    inline auto num_prio_task() noexcept -> size_t
+    {
+        return m_prio_queue[static_cast<size_t>(task_priority::high)].was_size() +
+               m_prio_queue[static_cast<size_t>(task_priority::low)].was_size();
+    }
+
+    /**
+     * @brief fetch one normal priority task handle, run-next slot, local task buffer
+     * and shared task queue are checked
+     *
+     * @return coroutine_handle<>, nullptr if no normal priority task
+     */
+    auto schedule_normal() noexcept -> coroutine_handle<>;
+
+    /**
+     * @brief fetch one task handle from the queue of priority class prio and count it
+     *
+     * @param prio must be high or low
+     * @param handle
+     * @return true if fetch successfully
+     */
+    auto pop_prio_task(task_priority prio, coroutine_handle<>& handle) noexcept -> bool;
+
+    /**
+     * @brief submit one task handle by the thread which owns this engine
+     *
+     * @param handle
+     */
+    auto submit_local_task(coroutine_handle<> handle) noexcept -> void;
+
+    /**
+     * @brief push one task handle into local task buffer, spill to shared task queue if buffer is full
+     *
+     * @param handle
+     */
+    auto push_local_task(coroutine_handle<> handle) noexcept -> void;
+
+    /**
+     * @brief fetch one task handle from local task buffer by config::kScheduleStrategy
+     *
+     * @return coroutine_handle<>, nullptr if local task buffer is empty
+     */
+    auto pop_local_task() noexcept -> coroutine_handle<>;
+
+    /**
+     * @brief return the number of task handles in cqe ready ring, run-next slot and local task buffer
+     *
+     * @return size_t
+     */
+    inline auto num_local_task() noexcept -> size_t
+    {
+        return m_num_cqe_ready + (m_run_next ? 1 : 0) + (m_local_tail - m_local_head);
+    }
+
+    /**
+     * @brief handle all finished io without blocking
+     *
+     */
+    auto reap_cqe() noexcept -> void;
+
+    /**
+     * @brief pop one coroutine staged by io callbacks during reap_cqe
+     *
+     * @return coroutine_handle<>, nullptr if cqe ready ring is empty
+     */
+    auto pop_cqe_ready() noexcept -> coroutine_handle<>;
+
+    /**
+     * @brief publish the load only visible to owner thread, see num_task_load
+     *
+     */
+    inline auto publish_load() noexcept -> void
+    {
+        m_local_load.store(num_local_task() + m_num_io_running + m_num_io_wait_submit, std::memory_order_relaxed);
+        m_stats.num_local_task.store(num_local_task(), std::memory_order_relaxed);
+        m_stats.num_io_running.store(m_num_io_running, std::memory_order_relaxed);
+        m_stats.num_io_wait_submit.store(m_num_io_wait_submit, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief record engine starts blocking, only called by owner thread
+     *
+     */
+    inline auto begin_idle() noexcept -> void { m_idle_since.store(steady_now_ns(), std::memory_order_relaxed); }
+
+    /**
+     * @brief add the time since begin_idle to idle time, only called by owner thread
+     *
+     */
+    inline auto end_idle() noexcept -> void
+    {
+        auto dura = steady_now_ns() - m_idle_since.load(std::memory_order_relaxed);
+        m_idle_since.store(0, std::memory_order_relaxed);
+        m_idle_time.store(m_idle_time.load(std::memory_order_relaxed) + dura, std::memory_order_relaxed);
+        stat_add(m_stats.num_wakeup, 1);
+    }
+
+    /**
+     * @brief spin on uring cq and shared task queue before engine sleeps,
+     * the spin time is bounded by m_spin_budget
+     *
+     * @return true if io is finished or task arrives during spin
+     */
+    auto busy_poll() noexcept -> bool;
+
+    /**
+     * @brief record the duration since busy poll starts to the time engine finds work,
+     * and tune m_spin_budget by the moving average of these durations
+     *
+     */
+    auto end_busy_poll() noexcept -> void;
+
+    /**
+     * @brief move the io consumed by kernel from wait-submit count to running count after a submit,
+     * sqe left by a failed or partial submit, such as -EINTR or -EBUSY, stays in submission queue
+     * and keeps being counted as wait-submit, so next poll submits it again
+     *
+     * @param ret the return value of the submit
+     */
+    auto settle_io_submit(int ret) noexcept -> void;
+
+    /**
+     * @brief poll_submit of submit_and_wait poll strategy, submit sqe and wait cqe in one syscall
+     *
+     */
+    auto poll_submit_and_wait() noexcept -> void;
+
+    /**
+     * @brief return true if cqe is produced by the read of eventfd armed by engine
+     *
+     * @param cqe
+     */
+    inline auto is_wakeup_cqe(urcptr cqe) noexcept -> bool
+    {
+        return io_uring_cqe_get_data(cqe) == static_cast<void*>(&m_efd_buf);
+    }
+
+    /**
+     * @brief return true if cqe is produced by the cancel request prepared by cancel_all_io
+     *
+     * @param cqe
+     */
+    inline auto is_cancel_cqe(urcptr cqe) noexcept -> bool
+    {
+        return io_uring_cqe_get_data(cqe) == static_cast<void*>(&m_cancel_tag);
+    }
+
+    /**
+     * @brief write task_flag to eventfd only if the owner thread has announced it
+     * is going to block in wait_eventfd, producers call this after pushing task
+     *
+     */
+    auto wake_up_if_sleeping() noexcept -> void;
+
+    /**
+     * @brief add num to a counter only written by owner thread, plain load and store
+     * is enough, so no locked instruction is paid on the hot path
+     *
+     * @param counter
+     * @param num
+     */
+    static inline auto stat_add(atomic<size_t>& counter, size_t num) noexcept -> void
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + num, std::memory_order_relaxed);
+    }
+
 private:
     uint32_t    m_id;
     uring_proxy m_upxy;
@@ -221,12 +643,89 @@ private:
     // store task handle
     mpmc_queue<coroutine_handle<>> m_task_queue; // You can replace it with another data structure
 
+    // store task handle when m_task_queue is full
+    segment_queue<coroutine_handle<>, config::kOverflowSegSize> m_overflow_queue;
+
+    // store high and low priority task handles, the slot of normal class is unused
+    // because normal tasks are stored in local buffer and shared task queue
+    array<segment_queue<coroutine_handle<>, config::kOverflowSegSize>, size_t(task_priority::none)> m_prio_queue;
+
+    // store task handles submitted by submit_pinned_task, other engines never steal them
+    segment_queue<coroutine_handle<>, config::kOverflowSegSize> m_pinned_queue;
+
+    // number of tasks fetched by schedule() of each priority class
+    array<size_t, size_t(task_priority::none)> m_num_task_run{};
+
     // used to fetch cqe entry
     array<urcptr, config::kQueCap> m_urc;
 
     // TODO[lab2a]: Add more member variables if you need
     size_t m_num_io_wait_submit{0};
     size_t m_num_io_running{0};
+
+    // below are only accessed by the thread which owns this engine,
+    // so tasks submitted by owner thread cost no atomic operation and no eventfd write
+    coroutine_handle<>                              m_run_next{nullptr};
+    array<coroutine_handle<>, config::kLocalQueCap> m_local_que;
+    size_t                                          m_local_head{0};
+    size_t                                          m_local_tail{0};
+    uint32_t                                        m_run_next_streak{0};
+    uint32_t                                        m_sched_tick{0};
+    uint32_t                                        m_high_prio_streak{0};
+
+    // ring of coroutines woken by io callbacks while reaping cqe, schedule() pops them
+    // before any other queue, owner-only, see config::kInlineCqeResume
+    array<coroutine_handle<>, config::kMaxInlineResume> m_cqe_ready;
+    size_t                                              m_cqe_ready_head{0};
+    size_t                                              m_num_cqe_ready{0};
+    size_t                                              m_num_inline_resume{0};
+    bool                                                m_reaping{false};
+
+    // true if last reap_cqe fetched as many cqes as it could, cq may still hold cqes
+    // whose eventfd count is consumed, so next poll must not block
+    bool m_cqe_backlog{false};
+
+    // set by the owner thread before it blocks in wait_eventfd, other threads submitting
+    // tasks skip the eventfd write unless this is true, so a busy engine costs no syscall
+    alignas(config::kCacheLineSize) atomic<bool> m_sleeping{false};
+
+    // load of local task buffer and io published by owner thread, read by dispatchers
+    atomic<size_t> m_local_load{0};
+
+    // nanoseconds blocked in waiting io or task and the start time of ongoing block (0 means not blocked),
+    // written by owner thread, read by scheduler scaler
+    atomic<uint64_t> m_idle_time{0};
+    atomic<uint64_t> m_idle_since{0};
+
+    // runtime counters, written only by owner thread and read by get_stats,
+    // own cache line so readers don't disturb the hot fields above
+    struct alignas(config::kCacheLineSize) stat_counters
+    {
+        atomic<size_t> num_task_exec{0};
+        atomic<size_t> num_cqe{0};
+        atomic<size_t> num_wakeup{0};
+        atomic<size_t> num_local_task{0};
+        atomic<size_t> num_io_running{0};
+        atomic<size_t> num_io_wait_submit{0};
+    } m_stats;
+
+    // used by submit_and_wait poll strategy, the read of eventfd kept in uring,
+    // its cqe is not counted in m_num_io_running
+    // m_efd_queued means the read is still in submission queue at position m_efd_sqe_pos
+    uint64_t     m_efd_buf{0};
+    bool         m_efd_armed{false};
+    bool         m_efd_queued{false};
+    unsigned int m_efd_sqe_pos{0};
+
+    // address used as user data of the cancel request, its cqe has no io_info to call back
+    uint8_t m_cancel_tag{0};
+
+    // busy poll state, all durations are in nanoseconds
+    std::chrono::steady_clock::time_point m_idle_start;
+    uint64_t                              m_idle_avg{0};
+    uint64_t                              m_spin_budget{uint64_t(config::kBusyPollMinTime) * 1000};
+    size_t                                m_num_spin_hit{0};
+    size_t                                m_num_spin_sleep{0};
 };
 
 /**
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <concepts>
 #include <coroutine>
 
 #include "coro/context.hpp"
@@ -9,8 +11,12 @@
 namespace coro::io::detail
 {
 
+class linked_timeout_awaiter;
+
 class base_io_awaiter
 {
+    friend class linked_timeout_awaiter;
+
 public:
     base_io_awaiter() noexcept : m_urs(coro::detail::local_engine().get_free_urs())
     {
@@ -25,9 +31,104 @@ public:
 
     auto await_resume() noexcept -> int32_t { return m_info.result; }
 
+    /**
+     * @brief the common io callback, store the cqe result and resume the awaiting coroutine
+     *
+     * @param data
+     * @param res
+     */
+    static auto resume_callback(io_info* data, int res) noexcept -> void
+    {
+        data->result = res;
+        submit_to_context(data->handle);
+    }
+
+    /**
+     * @brief bound this io by a linked timeout, if the io doesn't finish in duration kernel cancels it
+     * and co_await returns -ETIME, usage: co_await conn.read(buf, len).timeout(std::chrono::seconds(5));
+     *
+     * @note the returned awaiter refers to this awaiter, co_await it in the same expression
+     *
+     * @param duration
+     * @return linked_timeout_awaiter
+     */
+    auto timeout(std::chrono::nanoseconds duration) noexcept -> linked_timeout_awaiter;
+
 protected:
     io_info             m_info;
     coro::uring::ursptr m_urs;
 };
 
+static_assert(sizeof(base_io_awaiter) == sizeof(io_info) + sizeof(coro::uring::ursptr),
+              "optional io state such as linked timeout belongs to wrapper awaiters, not every io awaiter");
+
+/**
+ * @brief awaiter of one io bounded by a linked timeout, created by base_io_awaiter::timeout,
+ * it keeps the state of the timeout so io awaiters without timeout pay nothing for it
+ *
+ * @note the timeout sqe must directly follow the io sqe in submission queue, if another sqe is
+ * prepared between them, the io fails with -EINVAL, if submission queue is full, it fails with -EBUSY
+ */
+class linked_timeout_awaiter
+{
+public:
+    linked_timeout_awaiter(base_io_awaiter& io, std::chrono::nanoseconds duration) noexcept;
+
+    constexpr auto await_ready() noexcept -> bool { return false; }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> void;
+
+    auto await_resume() noexcept -> int32_t { return m_io.await_resume(); }
+
+private:
+    /**
+     * @brief the io can't be linked, turn its sqe into nop if kernel hasn't got it,
+     * then report res when its last cqe arrives
+     *
+     * @param res
+     * @param pending true if io sqe is still in submission queue
+     */
+    auto fail_link(int res, bool pending) noexcept -> void;
+
+    static auto io_callback(io_info* data, int res) noexcept -> void;
+
+    static auto timeout_callback(io_info* data, int res) noexcept -> void;
+
+    auto finish() noexcept -> void;
+
+private:
+    base_io_awaiter&  m_io;
+    io_info           m_timeout_info;
+    __kernel_timespec m_ts;
+    uintptr_t         m_io_data; // original data of io, restored before the io callback runs
+    cb_type           m_io_cb;   // original callback of io
+    int32_t           m_io_res{0}; // zero-copy send takes it from the first cqe, not the notification
+    uint32_t          m_io_cqe_flags{0};
+    int32_t           m_fail_res{0}; // not 0 if the io can't be linked
+    int               m_num_wait{0}; // cqes of the io and the timeout still expected
+};
+
+/**
+ * @brief generic awaiter of one uring operation, prep_func fills the sqe and the result of
+ * cqe is returned by co_await, so new operations don't need hand-written awaiter classes
+ *
+ * @tparam prep_func callable with signature void(io_uring_sqe*)
+ */
+template<typename prep_func>
+    requires std::invocable<prep_func&, coro::uring::ursptr>
+class uring_op_awaiter : public base_io_awaiter
+{
+public:
+    explicit uring_op_awaiter(prep_func prep, io_type type = io_type::none, int sqe_flag = 0) noexcept
+    {
+        m_info.type = type;
+        m_info.cb   = &base_io_awaiter::resume_callback;
+
+        prep(m_urs);
+        io_uring_sqe_set_flags(m_urs, sqe_flag);
+        io_uring_sqe_set_data(m_urs, &m_info);
+        coro::detail::local_engine().add_io_submit();
+    }
+};
+
 }; // namespace coro::io::detail
\ No newline at end of file
@@ -1,3 +1,7 @@
+#pragma once
+
+#include <utility>
+
 #include "coro/engine.hpp"
 
 namespace coro::io::detail
@@ -40,3 +44,69 @@ struct fixed_fds
     ::coro::uring::uring_fds_item item;
 };
 }; // namespace coro::io::detail
+
+namespace coro::io
+{
+/**
+ * @brief one buffer leased from the registered buffer pool of local engine, pass it to
+ * read_fixed/write_fixed so kernel skips pinning the pages for every io, it's given back
+ * when destroyed, usage:
+ *
+ * auto buf = io::fixed_buffer();
+ * if (buf.valid())
+ * {
+ *     auto n = co_await conn.read_fixed(buf, buf.size());
+ * }
+ *
+ * @note create and destroy it on the same context, the pool only has config::kFixedBufNum buffers,
+ * valid() is false when all of them are leased
+ */
+class fixed_buffer
+{
+public:
+    fixed_buffer() noexcept
+        : m_upxy(&::coro::detail::local_engine().get_uring()),
+          m_idx(m_upxy->lease_fixed_buf())
+    {
+    }
+
+    ~fixed_buffer() noexcept { return_back(); }
+
+    fixed_buffer(const fixed_buffer&)                    = delete;
+    auto operator=(const fixed_buffer&) -> fixed_buffer& = delete;
+
+    fixed_buffer(fixed_buffer&& other) noexcept : m_upxy(other.m_upxy), m_idx(std::exchange(other.m_idx, -1)) {}
+
+    auto operator=(fixed_buffer&& other) noexcept -> fixed_buffer&
+    {
+        if (this != &other)
+        {
+            return_back();
+            m_upxy = other.m_upxy;
+            m_idx  = std::exchange(other.m_idx, -1);
+        }
+        return *this;
+    }
+
+    inline auto valid() const noexcept -> bool { return m_idx >= 0; }
+
+    inline auto index() const noexcept -> int { return m_idx; }
+
+    inline auto data() const noexcept -> char* { return valid() ? m_upxy->get_fixed_buf(m_idx) : nullptr; }
+
+    constexpr auto size() const noexcept -> size_t { return ::coro::config::kFixedBufSize; }
+
+    inline auto return_back() noexcept -> void
+    {
+        if (valid())
+        {
+            m_upxy->return_fixed_buf(m_idx);
+            m_idx = -1;
+        }
+    }
+
+private:
+    ::coro::uring::uring_proxy* m_upxy;
+    int                         m_idx;
+};
+}; // namespace coro::io
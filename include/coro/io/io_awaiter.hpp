@@ -11,6 +11,8 @@
 #pragma once
 
 #include <netdb.h>
+#include <type_traits>
+#include <utility>
 
 #include "coro/io/base_awaiter.hpp"
 
@@ -33,6 +35,49 @@ public:
     static auto callback(io_info* data, int res) noexcept -> void;
 };
 
+/**
+ * @brief read into a registered buffer, buf must lie in the buffer buf_index of local engine,
+ * see fixed_buffer, offset is ignored by sockets and pipes
+ *
+ */
+class read_fixed_awaiter : public detail::base_io_awaiter
+{
+public:
+    read_fixed_awaiter(int fd, char* buf, size_t len, int buf_index, uint64_t offset = 0, int sqe_flag = 0) noexcept;
+
+    static auto callback(io_info* data, int res) noexcept -> void;
+};
+
+/**
+ * @brief write from a registered buffer, buf must lie in the buffer buf_index of local engine,
+ * see fixed_buffer, offset is ignored by sockets and pipes
+ *
+ */
+class write_fixed_awaiter : public detail::base_io_awaiter
+{
+public:
+    write_fixed_awaiter(int fd, char* buf, size_t len, int buf_index, uint64_t offset = 0, int sqe_flag = 0) noexcept;
+
+    static auto callback(io_info* data, int res) noexcept -> void;
+};
+
+/**
+ * @brief submit any uring operation without writing an awaiter class, prep fills the sqe,
+ * usage: auto res = co_await uring_op([&](io_uring_sqe* sqe) { io_uring_prep_fsync(sqe, fd, 0); });
+ *
+ * @note prep must not call io_uring_sqe_set_data, the sqe data is owned by the awaiter
+ *
+ * @param prep callable with signature void(io_uring_sqe*)
+ * @param sqe_flag
+ * @return detail::uring_op_awaiter, co_await it returns the cqe result
+ */
+template<typename prep_func>
+    requires std::invocable<std::decay_t<prep_func>&, coro::uring::ursptr>
+inline auto uring_op(prep_func&& prep, int sqe_flag = 0) noexcept -> detail::uring_op_awaiter<std::decay_t<prep_func>>
+{
+    return detail::uring_op_awaiter<std::decay_t<prep_func>>(std::forward<prep_func>(prep), detail::io_type::none, sqe_flag);
+}
+
 namespace net
 {
 /**
@@ -68,6 +113,31 @@ public:
     static auto callback(io_info* data, int res) noexcept -> void;
 };
 
+/**
+ * @brief zero-copy send, the kernel sends from buf directly instead of copying it into the socket buffer,
+ * co_await returns the bytes sent only after the notification cqe says buf can be reused,
+ * len below config::kSendZcThreshold falls back to normal send
+ *
+ */
+class tcp_send_zc_awaiter : public detail::base_io_awaiter
+{
+public:
+    tcp_send_zc_awaiter(int sockfd, char* buf, size_t len, int io_flag = 0, int sqe_flag = 0) noexcept;
+
+    static auto callback(io_info* data, int res) noexcept -> void;
+};
+
+/**
+ * @brief zero-copy sendmsg, msg and the buffers it points to must stay alive until co_await returns,
+ * total length below config::kSendZcThreshold falls back to normal sendmsg
+ *
+ */
+class tcp_sendmsg_zc_awaiter : public detail::base_io_awaiter
+{
+public:
+    tcp_sendmsg_zc_awaiter(int sockfd, const msghdr* msg, int io_flag = 0, int sqe_flag = 0) noexcept;
+};
+
 class tcp_close_awaiter : public detail::base_io_awaiter
 {
 public:
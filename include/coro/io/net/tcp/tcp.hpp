@@ -4,10 +4,13 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <netdb.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <utility>
+#include <vector>
 
 #include "config.h"
 #include "coro/io/base_io_type.hpp"
@@ -16,6 +19,191 @@
 namespace coro::io::net::tcp
 {
 
+/**
+ * @brief data of one recv cqe from tcp_recv_stream, it owns a buffer of the provided buffer ring
+ * and gives it back to the ring when destroyed or released
+ *
+ * @note release it on the context which received it, and don't keep it long,
+ * the ring has only config::kBufRingEntries buffers shared by all connections of the context
+ */
+class tcp_recv_buffer
+{
+public:
+    tcp_recv_buffer() noexcept = default;
+
+    tcp_recv_buffer(int res, char* data, uint16_t bid, ::coro::uring::uring_proxy* upxy) noexcept
+        : m_res(res),
+          m_bid(bid),
+          m_data(data),
+          m_upxy(upxy)
+    {
+    }
+
+    ~tcp_recv_buffer() noexcept { release(); }
+
+    tcp_recv_buffer(const tcp_recv_buffer&)                    = delete;
+    auto operator=(const tcp_recv_buffer&) -> tcp_recv_buffer& = delete;
+
+    tcp_recv_buffer(tcp_recv_buffer&& other) noexcept
+        : m_res(other.m_res),
+          m_bid(other.m_bid),
+          m_data(std::exchange(other.m_data, nullptr)),
+          m_upxy(other.m_upxy)
+    {
+    }
+
+    auto operator=(tcp_recv_buffer&& other) noexcept -> tcp_recv_buffer&
+    {
+        if (this != &other)
+        {
+            release();
+            m_res  = other.m_res;
+            m_bid  = other.m_bid;
+            m_data = std::exchange(other.m_data, nullptr);
+            m_upxy = other.m_upxy;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief return the number of received bytes, 0 means peer closed, negative errno means error,
+     * -ENOBUFS means the buffer ring was empty and next() can be called again to retry
+     *
+     * @return int
+     */
+    auto result() const noexcept -> int { return m_res; }
+
+    /**
+     * @brief return the received data, nullptr if result() <= 0
+     *
+     * @return char*
+     */
+    auto data() const noexcept -> char* { return m_data; }
+
+    /**
+     * @brief give the buffer back to the ring before destroy
+     *
+     */
+    auto release() noexcept -> void
+    {
+        if (m_data != nullptr)
+        {
+            m_upxy->recycle_buf(m_bid);
+            m_data = nullptr;
+        }
+    }
+
+private:
+    int                         m_res{0};
+    uint16_t                    m_bid{0};
+    char*                       m_data{nullptr};
+    ::coro::uring::uring_proxy* m_upxy{nullptr};
+};
+
+/**
+ * @brief multishot recv with the provided buffer ring of the engine, the kernel picks a buffer
+ * only when data arrives, so idle connections hold no buffer, usage:
+ *
+ * auto stream = conn.recv_stream();
+ * while (true)
+ * {
+ *     auto buf = co_await stream.next();
+ *     if (buf.result() <= 0)
+ *     {
+ *         break;
+ *     }
+ *     co_await conn.write(buf.data(), buf.result());
+ * }
+ * co_await stream.cancel();
+ *
+ * @note the stream must be used by one coroutine on the context which created it,
+ * and cancel must be awaited before the stream is destroyed if next has been called
+ */
+class tcp_recv_stream
+{
+public:
+    tcp_recv_stream(int sockfd, int io_flag, int sqe_flag) noexcept;
+
+    // buffers received but not taken go back to the ring
+    ~tcp_recv_stream() noexcept;
+
+    tcp_recv_stream(const tcp_recv_stream&)                    = delete;
+    tcp_recv_stream(tcp_recv_stream&&)                         = delete;
+    auto operator=(const tcp_recv_stream&) -> tcp_recv_stream& = delete;
+    auto operator=(tcp_recv_stream&&) -> tcp_recv_stream&      = delete;
+
+    struct next_awaiter
+    {
+        auto await_ready() noexcept -> bool { return m_stream.m_head != m_stream.m_items.size(); }
+
+        auto await_suspend(std::coroutine_handle<> handle) noexcept -> bool;
+
+        auto await_resume() noexcept -> tcp_recv_buffer;
+
+        tcp_recv_stream& m_stream;
+    };
+
+    struct cancel_awaiter
+    {
+        auto await_ready() noexcept -> bool { return !m_stream.m_armed; }
+
+        auto await_suspend(std::coroutine_handle<> handle) noexcept -> void;
+
+        constexpr auto await_resume() noexcept -> void {}
+
+        tcp_recv_stream& m_stream;
+    };
+
+    /**
+     * @brief co_await it to get the next received data, the multishot recv is armed at
+     * the first call and rearmed if kernel stops it, the result is -EOPNOTSUPP if
+     * provided buffer ring is unavailable
+     *
+     * @return next_awaiter
+     */
+    auto next() noexcept -> next_awaiter { return {*this}; }
+
+    /**
+     * @brief co_await it to stop the multishot recv, it resumes after kernel posts the last cqe
+     *
+     * @return cancel_awaiter
+     */
+    auto cancel() noexcept -> cancel_awaiter { return {*this}; }
+
+private:
+    struct recv_item
+    {
+        int res;
+        int bid; // -1 if cqe carries no buffer
+    };
+
+    // return false and queue -EOPNOTSUPP if provided buffer ring is unavailable
+    auto arm() noexcept -> bool;
+
+    static auto recv_callback(io_info* data, int res) noexcept -> void;
+
+    static auto cancel_callback(io_info* data, int res) noexcept -> void;
+
+    auto finish_cancel() noexcept -> void;
+
+private:
+    int m_sockfd;
+    int m_io_flag;
+    int m_sqe_flag;
+
+    io_info m_info;
+    io_info m_cancel_info;
+    // an empty vector holds no heap memory while an empty deque does, idle streams stay small
+    std::vector<recv_item>      m_items;
+    size_t                      m_head{0};
+    ::coro::uring::uring_proxy* m_upxy;
+    std::coroutine_handle<>     m_waiter{nullptr};
+    std::coroutine_handle<>     m_cancel_waiter{nullptr};
+    bool                        m_armed{false};
+    // cqes still expected before cancel resumes: the last cqe of recv and the cqe of cancel
+    int m_num_cancel_wait{0};
+};
+
 class tcp_connector
 {
 public:
@@ -34,6 +222,68 @@ public:
         return tcp_write_awaiter(m_sockfd, buf, len, io_flags, m_sqe_flag);
     }
 
+    /**
+     * @brief send buf without copying it into the socket buffer, see tcp_send_zc_awaiter
+     *
+     * @param buf must not be modified until co_await returns
+     * @param len
+     * @param io_flags
+     * @return tcp_send_zc_awaiter
+     */
+    tcp_send_zc_awaiter write_zc(char* buf, size_t len, int io_flags = 0) noexcept
+    {
+        return tcp_send_zc_awaiter(m_sockfd, buf, len, io_flags, m_sqe_flag);
+    }
+
+    /**
+     * @brief sendmsg without copying the buffers into the socket buffer, see tcp_sendmsg_zc_awaiter
+     *
+     * @param msg
+     * @param io_flags
+     * @return tcp_sendmsg_zc_awaiter
+     */
+    tcp_sendmsg_zc_awaiter sendmsg_zc(const msghdr* msg, int io_flags = 0) noexcept
+    {
+        return tcp_sendmsg_zc_awaiter(m_sockfd, msg, io_flags, m_sqe_flag);
+    }
+
+    /**
+     * @brief read into registered buffer buf, the kernel doesn't pin its pages for every read
+     *
+     * @param buf
+     * @param len no more than buf.size()
+     * @return read_fixed_awaiter
+     */
+    read_fixed_awaiter read_fixed(fixed_buffer& buf, size_t len) noexcept
+    {
+        assert(buf.valid() && len <= buf.size());
+        return read_fixed_awaiter(m_sockfd, buf.data(), len, buf.index(), 0, m_sqe_flag);
+    }
+
+    /**
+     * @brief write from registered buffer buf, the kernel doesn't pin its pages for every write
+     *
+     * @param buf
+     * @param len no more than buf.size()
+     * @return write_fixed_awaiter
+     */
+    write_fixed_awaiter write_fixed(fixed_buffer& buf, size_t len) noexcept
+    {
+        assert(buf.valid() && len <= buf.size());
+        return write_fixed_awaiter(m_sockfd, buf.data(), len, buf.index(), 0, m_sqe_flag);
+    }
+
+    /**
+     * @brief return a multishot recv stream of this connection, see tcp_recv_stream
+     *
+     * @param io_flags
+     * @return tcp_recv_stream
+     */
+    tcp_recv_stream recv_stream(int io_flags = 0) noexcept
+    {
+        return tcp_recv_stream(m_sockfd, io_flags, m_sqe_flag);
+    }
+
     // close() must use original sock fd
     tcp_close_awaiter close() noexcept
     {
@@ -49,6 +299,95 @@ private:
     int               m_sqe_flag;
 };
 
+/**
+ * @brief multishot accept, one armed sqe keeps accepting connections, each accepted fd
+ * is queued here until next() takes it, usage:
+ *
+ * auto stream = server.accept_stream();
+ * int  fd;
+ * while ((fd = co_await stream.next()) > 0)
+ * {
+ *     submit_to_scheduler(session(fd));
+ * }
+ * co_await stream.cancel();
+ *
+ * @note the stream must be used by one coroutine on the context which created it,
+ * and cancel must be awaited before the stream is destroyed if next has been called
+ */
+class tcp_accept_stream
+{
+public:
+    tcp_accept_stream(int listenfd, int io_flag, int sqe_flag) noexcept;
+
+    // fds accepted but not taken are closed
+    ~tcp_accept_stream() noexcept;
+
+    tcp_accept_stream(const tcp_accept_stream&)                    = delete;
+    tcp_accept_stream(tcp_accept_stream&&)                         = delete;
+    auto operator=(const tcp_accept_stream&) -> tcp_accept_stream& = delete;
+    auto operator=(tcp_accept_stream&&) -> tcp_accept_stream&      = delete;
+
+    struct next_awaiter
+    {
+        auto await_ready() noexcept -> bool { return !m_stream.m_fds.empty(); }
+
+        auto await_suspend(std::coroutine_handle<> handle) noexcept -> void;
+
+        auto await_resume() noexcept -> int;
+
+        tcp_accept_stream& m_stream;
+    };
+
+    struct cancel_awaiter
+    {
+        auto await_ready() noexcept -> bool { return !m_stream.m_armed; }
+
+        auto await_suspend(std::coroutine_handle<> handle) noexcept -> void;
+
+        constexpr auto await_resume() noexcept -> void {}
+
+        tcp_accept_stream& m_stream;
+    };
+
+    /**
+     * @brief co_await it to get the next accepted fd, or a negative errno if accept fails,
+     * the multishot accept is armed at the first call and rearmed if kernel stops it
+     *
+     * @return next_awaiter
+     */
+    auto next() noexcept -> next_awaiter { return {*this}; }
+
+    /**
+     * @brief co_await it to stop the multishot accept, it resumes after kernel posts the last cqe
+     *
+     * @return cancel_awaiter
+     */
+    auto cancel() noexcept -> cancel_awaiter { return {*this}; }
+
+private:
+    auto arm() noexcept -> void;
+
+    static auto accept_callback(io_info* data, int res) noexcept -> void;
+
+    static auto cancel_callback(io_info* data, int res) noexcept -> void;
+
+    auto finish_cancel() noexcept -> void;
+
+private:
+    int m_listenfd;
+    int m_io_flag;
+    int m_sqe_flag;
+
+    io_info                 m_info;
+    io_info                 m_cancel_info;
+    std::deque<int>         m_fds;
+    std::coroutine_handle<> m_waiter{nullptr};
+    std::coroutine_handle<> m_cancel_waiter{nullptr};
+    bool                    m_armed{false};
+    // cqes still expected before cancel resumes: the last cqe of accept and the cqe of cancel
+    int m_num_cancel_wait{0};
+};
+
 class tcp_server
 {
 public:
@@ -58,6 +397,22 @@ public:
 
     tcp_accept_awaiter accept(int io_flags = 0) noexcept;
 
+    /**
+     * @brief return a multishot accept stream of this server, see tcp_accept_stream
+     *
+     * @param io_flags
+     * @return tcp_accept_stream
+     */
+    tcp_accept_stream accept_stream(int io_flags = 0) noexcept;
+
+    /**
+     * @brief return the port server listens on, if server is created with port 0,
+     * this is the port chosen by kernel
+     *
+     * @return int
+     */
+    inline auto port() const noexcept -> int { return m_port; }
+
 private:
     int         m_listenfd;
     int         m_port;
@@ -2,7 +2,6 @@
 
 #include <coroutine>
 #include <cstdint>
-#include <functional>
 
 namespace coro::net::detail
 {
@@ -12,9 +11,11 @@ namespace coro::net::detail
 struct io_info;
 
 using std::coroutine_handle;
-using cb_type = std::function<void(io_info*, int)>;
+// all io callbacks are static functions, a plain function pointer keeps io_info trivially
+// copyable and lets handle_cqe_entry call it directly without type erasure
+using cb_type = void (*)(io_info*, int);
 
-enum io_type
+enum io_type : uint8_t
 {
     nop,
     tcp_accept,
@@ -27,15 +28,19 @@ enum io_type
     none
 };
 
+// fields are ordered by size so the struct has no inner padding
 struct io_info
 {
     coroutine_handle<> handle;
-    int32_t            result;
-    io_type            type;
     uintptr_t          data;
     cb_type            cb;
+    int32_t            result;
+    uint32_t           cqe_flags; // flags of the cqe being handled, set by engine before cb is called
+    io_type            type;
 };
 
+static_assert(sizeof(io_info) == 40, "io_info should stay compact, it lives in every io awaiter");
+
 inline uintptr_t ioinfo_to_ptr(io_info* info) noexcept
 {
     return reinterpret_cast<uintptr_t>(info);
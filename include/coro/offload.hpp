@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+#include "coro/attribute.hpp"
+#include "coro/context.hpp"
+#include "coro/detail/container.hpp"
+#include "coro/detail/void_value.hpp"
+
+namespace coro
+{
+/**
+ * @brief metrics of offload pool, all durations are in nanoseconds
+ *
+ */
+struct offload_stats
+{
+    size_t   num_thread{0};
+    size_t   queue_depth{0};     // jobs waiting for a free thread now
+    size_t   max_queue_depth{0}; // the max queue depth since process starts
+    size_t   num_submit{0};
+    size_t   num_finish{0};
+    uint64_t total_wait_time{0}; // time from submit to the job starts running
+    uint64_t max_wait_time{0};
+    uint64_t total_run_time{0};
+};
+
+namespace detail
+{
+/**
+ * @brief one callable waiting to run in offload pool, cb runs the callable and stores its result,
+ * then pool submits handle back to ctx, ctx is cleared if ctx is forced to stop meanwhile
+ *
+ */
+struct offload_job
+{
+    using callback_type = void (*)(offload_job*);
+
+    callback_type           cb{nullptr};
+    offload_job*            next{nullptr};
+    uint64_t                submit_time{0};
+    context*                ctx{nullptr};
+    std::coroutine_handle<> handle{nullptr};
+};
+
+/**
+ * @brief bounded thread pool which runs blocking calls out of contexts,
+ * the threads are created when the first job is submitted
+ *
+ */
+class offload_pool
+{
+public:
+    static auto get_instance() noexcept -> offload_pool*
+    {
+        static offload_pool pool;
+        return &pool;
+    }
+
+    ~offload_pool() noexcept;
+
+    /**
+     * @brief push job to the queue, one idle thread will run it
+     *
+     * @note this is thread-safe
+     *
+     * @param job
+     */
+    auto submit(offload_job* job) noexcept -> void;
+
+    /**
+     * @brief return the metrics of pool
+     *
+     * @note this is thread-safe
+     *
+     * @return offload_stats
+     */
+    auto get_stats() noexcept -> offload_stats;
+
+    /**
+     * @brief drop the jobs submitted from ctx, queued jobs are removed and their coroutines are
+     * cleaned, running jobs are not resumed after func returns, called by a context which is
+     * forced to stop so no coroutine is submitted to it after it deinits
+     *
+     * @note this is thread-safe, must be called by the working thread of ctx
+     *
+     * @param ctx
+     * @return size_t number of dropped jobs
+     */
+    auto cancel(context* ctx) noexcept -> size_t;
+
+private:
+    offload_pool() noexcept = default;
+
+    auto start() noexcept -> void;
+
+    auto run(std::stop_token token) noexcept -> void;
+
+private:
+    std::once_flag              m_start_flag;
+    std::mutex                  m_mtx;
+    std::condition_variable_any m_cv;
+
+    // fifo list of jobs, guarded by m_mtx
+    offload_job* m_head{nullptr};
+    offload_job* m_tail{nullptr};
+    size_t       m_queue_depth{0};
+
+    // jobs whose func is running, guarded by m_mtx, cancel() clears their ctx
+    std::vector<offload_job*> m_running;
+    size_t       m_max_queue_depth{0};
+
+    std::atomic<size_t>   m_num_submit{0};
+    std::atomic<size_t>   m_num_finish{0};
+    std::atomic<uint64_t> m_total_wait_time{0};
+    std::atomic<uint64_t> m_max_wait_time{0};
+    std::atomic<uint64_t> m_total_run_time{0};
+
+    // declared last so threads are joined before the queue is destroyed
+    std::vector<std::jthread> m_threads;
+};
+
+/**
+ * @brief run func in offload pool and resume the awaiting coroutine on the context it came from,
+ * the return value or exception of func is returned or rethrown by co_await
+ *
+ * @tparam func_type
+ */
+template<typename func_type>
+class [[CORO_AWAIT_HINT]] offload_awaiter : public offload_job
+{
+    using return_type = std::invoke_result_t<func_type&>;
+    using value_type  = std::conditional_t<std::is_void_v<return_type>, void_value, return_type>;
+
+public:
+    explicit offload_awaiter(func_type func) noexcept : m_func(std::move(func)) { cb = &offload_awaiter::run_job; }
+
+    constexpr auto await_ready() noexcept -> bool { return false; }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> void
+    {
+        // 提交前增加引用计数，避免 context 在 func 执行期间认为自己空闲而退出
+        this->handle = handle;
+        this->ctx    = &local_context();
+        this->ctx->register_wait();
+        offload_pool::get_instance()->submit(this);
+    }
+
+    auto await_resume() -> return_type
+    {
+        this->ctx->unregister_wait();
+        if (m_exception)
+        {
+            std::rethrow_exception(m_exception);
+        }
+        if constexpr (!std::is_void_v<return_type>)
+        {
+            return std::move(m_result).result();
+        }
+    }
+
+private:
+    static auto run_job(offload_job* job) noexcept -> void
+    {
+        auto self = static_cast<offload_awaiter*>(job);
+        try
+        {
+            if constexpr (std::is_void_v<return_type>)
+            {
+                self->m_func();
+            }
+            else
+            {
+                self->m_result.return_value(self->m_func());
+            }
+        }
+        catch (...)
+        {
+            // 异常单独保存，container 对 pod 类型的 result() 是 noexcept 的，不能在其中重新抛出
+            self->m_exception = std::current_exception();
+        }
+    }
+
+    func_type             m_func;
+    container<value_type> m_result;
+    std::exception_ptr    m_exception{nullptr};
+};
+}; // namespace detail
+
+/**
+ * @brief run blocking call or cpu heavy call in offload pool, so the context keeps processing
+ * other tasks and io, usage: auto ret = co_await coro::offload([]() { return blocking_call(); });
+ *
+ * @note the pool has config::kOffloadThreadNum threads, jobs beyond that wait in queue
+ *
+ * @param func callable without arguments
+ * @return detail::offload_awaiter
+ */
+template<typename func_type>
+    requires std::invocable<std::decay_t<func_type>&>
+inline auto offload(func_type&& func) noexcept -> detail::offload_awaiter<std::decay_t<func_type>>
+{
+    return detail::offload_awaiter<std::decay_t<func_type>>(std::forward<func_type>(func));
+}
+
+/**
+ * @brief return the metrics of offload pool, such as queue depth and wait latency
+ *
+ * @return offload_stats
+ */
+inline auto get_offload_stats() noexcept -> offload_stats
+{
+    return detail::offload_pool::get_instance()->get_stats();
+}
+
+}; // namespace coro
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
+#include <chrono>
+#include <limits>
 #include <memory>
+#include <span>
 #include <thread>
 #include <vector>
 
@@ -15,6 +19,35 @@
 namespace coro
 {
 
+/**
+ * @brief result of scheduler::shutdown
+ *
+ */
+struct shutdown_report
+{
+    // true if all tasks and io finished before deadline, otherwise contexts are stopped by force
+    bool   drained{true};
+    // queued tasks dropped by forced stop, detached tasks are destroyed
+    size_t num_cancelled_task{0};
+    // io cancelled and waits (such as event or mutex waiters) still pending when contexts are stopped by force,
+    // coroutines awaiting the cancelled io resume with -ECANCELED before contexts stop
+    size_t num_cancelled_io{0};
+    // tasks submitted from outside contexts after shutdown begins, they are destroyed if detached
+    size_t num_rejected_task{0};
+};
+
+/**
+ * @brief result of scheduler::snapshot_stats
+ *
+ */
+struct scheduler_stats
+{
+    // one entry per context, include retired contexts of elastic mode
+    std::vector<context_stats> ctxs;
+    // counters summed over all contexts, high-water marks take the max
+    context_stats total;
+};
+
 /**
  * @brief scheduler just control context to run and stop,
  * it also use dispatcher to decide which context can accept the task
@@ -29,54 +62,421 @@ class scheduler
     using stop_flag_type =std::vector<detail::atomic_ref_wrapper<int>>;
 
 public:
-    [[CORO_TEST_USED(lab2b)]] inline static auto init(size_t ctx_cnt = std::thread::hardware_concurrency()) noexcept
-        -> void
+    /**
+     * @brief create an independent scheduler instance with ctx_cnt contexts and its own dispatcher,
+     * it doesn't share contexts with the default instance used by the static api without scheduler
+     * argument, so noisy work in one instance can't delay tasks of another
+     *
+     * @note drive it by the static api which takes scheduler& as the first argument, such as
+     * scheduler::loop(sc) and scheduler::submit(sc, task)
+     *
+     * @param ctx_cnt 0 means the number of hardware threads
+     * @param aff how to pin the working thread of each context to cpus
+     */
+    explicit scheduler(size_t ctx_cnt, detail::affinity_strategy aff = detail::affinity_strategy::unbound) noexcept;
+
+    /**
+     * @brief create an independent scheduler instance with one context per cpu list
+     *
+     * @param cpu_lists
+     */
+    explicit scheduler(const std::vector<utils::cpu_list>& cpu_lists) noexcept;
+
+    /**
+     * @brief a started instance which is not shut down is shut down at once, its queued tasks are cancelled
+     *
+     */
+    ~scheduler() noexcept;
+
+    scheduler(const scheduler&)                    = delete;
+    scheduler(scheduler&&)                         = delete;
+    auto operator=(const scheduler&) -> scheduler& = delete;
+    auto operator=(scheduler&&) -> scheduler&      = delete;
+
+    /**
+     * @brief return the scheduler which owns the context of current thread, if current thread
+     * is not a working thread of any scheduler, return the default instance
+     *
+     * @return scheduler&
+     */
+    static auto current() noexcept -> scheduler&;
+
+    /**
+     * @brief init scheduler with ctx_cnt contexts
+     *
+     * @param ctx_cnt 0 means the number of hardware threads
+     * @param aff how to pin the working thread of each context to cpus
+     */
+    [[CORO_TEST_USED(lab2b)]] inline static auto init(
+        size_t ctx_cnt = std::thread::hardware_concurrency(),
+        detail::affinity_strategy aff = detail::affinity_strategy::unbound) noexcept -> void
     {
         if (ctx_cnt == 0)
         {
             ctx_cnt = std::thread::hardware_concurrency();
         }
-        get_instance()->init_impl(ctx_cnt);
+        get_instance()->init_impl(plan_affinity(ctx_cnt, aff), ctx_cnt);
+    }
+
+    /**
+     * @brief init scheduler with one context per cpu list, the working thread of context i
+     * is pinned to cpu_lists[i], empty list means no affinity
+     *
+     * @param cpu_lists
+     */
+    inline static auto init(const std::vector<utils::cpu_list>& cpu_lists) noexcept -> void
+    {
+        assert(!cpu_lists.empty() && "scheduler init with empty cpu lists");
+        get_instance()->init_impl(cpu_lists, cpu_lists.size());
+    }
+
+    /**
+     * @brief init scheduler with max_ctx contexts but only min_ctx of them run at first,
+     * after start(), contexts are added when they are overloaded and retired when they are idle,
+     * the number of running contexts is kept in [min_ctx, max_ctx], see config::kScaleInterval
+     *
+     * @note loop() doesn't scale, only min_ctx contexts run in short run mode
+     *
+     * @param min_ctx
+     * @param max_ctx 0 means the number of hardware threads
+     * @param aff how to pin the working thread of each context to cpus
+     */
+    inline static auto init_elastic(
+        size_t min_ctx, size_t max_ctx = 0, detail::affinity_strategy aff = detail::affinity_strategy::unbound) noexcept
+        -> void
+    {
+        if (max_ctx == 0)
+        {
+            max_ctx = std::thread::hardware_concurrency();
+        }
+        assert(min_ctx > 0 && min_ctx <= max_ctx && "scheduler init with invalid elastic bounds");
+        get_instance()->init_impl(plan_affinity(max_ctx, aff), min_ctx);
     }
 
+    /**
+     * @brief return the number of contexts which accept new tasks
+     *
+     * @return size_t
+     */
+    inline static auto num_active_ctx() noexcept -> size_t
+    {
+        return get_instance()->m_num_active.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief return the id of the index-th context of scheduler, used to pick the target of switch_to
+     *
+     * @param index in range [0, num_active_ctx())
+     * @return ctx_id
+     */
+    inline static auto ctx_id_of(size_t index) noexcept -> ctx_id
+    {
+        auto sc = get_instance();
+        assert(index < sc->m_ctxs.size() && "context index out of range");
+        return sc->m_ctxs[index]->get_ctx_id();
+    }
+
+    /**
+     * @brief collect the runtime counters of all contexts, used to size queues and uring
+     * entries or tell load imbalance from slow handlers
+     *
+     * @note this is thread-safe and cheap, counters are read without stopping contexts
+     *
+     * @return scheduler_stats
+     */
+    inline static auto snapshot_stats() noexcept -> scheduler_stats { return get_instance()->snapshot_stats_impl(); }
+
     /**
      * @brief loop work mode, auto wait all context finish job
      *
      */
     [[CORO_TEST_USED(lab2b)]] inline static auto loop() noexcept -> void { get_instance()->loop_impl(); }
 
-    static inline auto submit(task<void>&& task) noexcept -> void
+    /**
+     * @brief long run work mode, contexts start running and never stop by themselves,
+     * an idle context parks on its eventfd until new task arrives, call shutdown to stop them
+     *
+     * @note submit costs no stop-token accounting in this mode
+     */
+    inline static auto start() noexcept -> void { get_instance()->start_long_run_impl(); }
+
+    /**
+     * @brief stop the scheduler started by start(), new tasks submitted from outside contexts
+     * are rejected, contexts drain their tasks and io until deadline, then the rest are cancelled
+     *
+     * @note tasks running in contexts can still submit tasks while draining,
+     * these tasks are put into the submitter's own context
+     *
+     * @param deadline
+     * @return shutdown_report
+     */
+    inline static auto shutdown(std::chrono::steady_clock::time_point deadline) noexcept -> shutdown_report
+    {
+        return get_instance()->shutdown_impl(deadline);
+    }
+
+    /**
+     * @brief same as shutdown(now + timeout)
+     *
+     * @param timeout
+     * @return shutdown_report
+     */
+    template<typename rep, typename period>
+    inline static auto shutdown(std::chrono::duration<rep, period> timeout) noexcept -> shutdown_report
+    {
+        return shutdown(std::chrono::steady_clock::now() + timeout);
+    }
+
+    static inline auto submit(task<void>&& task, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        auto handle = task.handle();
+        task.detach();
+        submit(handle, prio);
+    }
+
+    static inline auto submit(task<void>& task, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        submit(task.handle(), prio);
+    }
+
+    /**
+     * @brief submit one task handle to the context chosen by dispatcher
+     *
+     * @param handle
+     * @param prio priority class of task, high priority tasks run ahead of
+     * normal and low ones queued in the same context
+     */
+    [[CORO_TEST_USED(lab2b)]] inline static auto submit(
+        std::coroutine_handle<> handle, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        get_instance()->submit_task_impl(handle, prio);
+    }
+
+    /**
+     * @brief submit tasks in batch, tasks in range are detached and owned by scheduler
+     *
+     * @param tasks
+     * @param prio priority class of all tasks
+     */
+    template<concepts::range_of<task<void>> range_type>
+    static inline auto submit_batch(range_type&& tasks, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        auto handles = detail::detach_tasks(tasks);
+        submit_batch(std::span<const std::coroutine_handle<>>(handles), prio);
+    }
+
+    /**
+     * @brief submit task handles in batch, handles are partitioned into contiguous chunks,
+     * each target context gets its chunk by one bulk push and is woken up at most once
+     *
+     * @param handles
+     * @param prio priority class of all tasks
+     */
+    static inline auto submit_batch(
+        std::span<const std::coroutine_handle<>> handles, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        get_instance()->submit_batch_impl(handles, prio);
+    }
+
+    static inline auto submit_by_key(task<void>&& task, uint64_t key, task_priority prio = task_priority::normal) noexcept
+        -> void
+    {
+        auto handle = task.handle();
+        task.detach();
+        submit_by_key(handle, key, prio);
+    }
+
+    /**
+     * @brief submit one task handle with key, if dispatch strategy is affinity_hash,
+     * tasks of the same key always run in the same context, other strategies ignore key
+     *
+     * @param handle
+     * @param key such as session id or connection fd
+     * @param prio priority class of task
+     */
+    static inline auto submit_by_key(
+        std::coroutine_handle<> handle, uint64_t key, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        get_instance()->submit_by_key_impl(handle, key, prio);
+    }
+
+    /**
+     * @brief submit one task handle to the context whose id is id, if that context is
+     * not active, the handle is submitted to the context chosen by dispatcher
+     *
+     * @param handle
+     * @param id such as ctx_id_of(i) or local_context().get_ctx_id()
+     * @param prio priority class of task
+     */
+    static inline auto submit_to(
+        std::coroutine_handle<> handle, ctx_id id, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        get_instance()->submit_to_id_impl(handle, id, prio);
+    }
+
+    /**
+     * @brief the api below works like the api of the same name above,
+     * but targets scheduler instance sc instead of the default instance
+     *
+     */
+    inline static auto num_active_ctx(scheduler& sc) noexcept -> size_t
+    {
+        return sc.m_num_active.load(std::memory_order_acquire);
+    }
+
+    inline static auto ctx_id_of(scheduler& sc, size_t index) noexcept -> ctx_id
+    {
+        assert(index < sc.m_ctxs.size() && "context index out of range");
+        return sc.m_ctxs[index]->get_ctx_id();
+    }
+
+    inline static auto snapshot_stats(scheduler& sc) noexcept -> scheduler_stats { return sc.snapshot_stats_impl(); }
+
+    inline static auto loop(scheduler& sc) noexcept -> void { sc.loop_impl(); }
+
+    inline static auto start(scheduler& sc) noexcept -> void { sc.start_long_run_impl(); }
+
+    inline static auto shutdown(scheduler& sc, std::chrono::steady_clock::time_point deadline) noexcept
+        -> shutdown_report
+    {
+        return sc.shutdown_impl(deadline);
+    }
+
+    template<typename rep, typename period>
+    inline static auto shutdown(scheduler& sc, std::chrono::duration<rep, period> timeout) noexcept -> shutdown_report
+    {
+        return sc.shutdown_impl(std::chrono::steady_clock::now() + timeout);
+    }
+
+    static inline auto submit(scheduler& sc, task<void>&& task, task_priority prio = task_priority::normal) noexcept
+        -> void
     {
         auto handle = task.handle();
         task.detach();
-        submit(handle);
+        sc.submit_task_impl(handle, prio);
     }
 
-    static inline auto submit(task<void>& task) noexcept -> void { submit(task.handle()); }
+    static inline auto submit(
+        scheduler& sc, std::coroutine_handle<> handle, task_priority prio = task_priority::normal) noexcept -> void
+    {
+        sc.submit_task_impl(handle, prio);
+    }
 
-    [[CORO_TEST_USED(lab2b)]] inline static auto submit(std::coroutine_handle<> handle) noexcept -> void
+    static inline auto submit_batch(
+        scheduler&                               sc,
+        std::span<const std::coroutine_handle<>> handles,
+        task_priority                            prio = task_priority::normal) noexcept -> void
     {
-        get_instance()->submit_task_impl(handle);
+        sc.submit_batch_impl(handles, prio);
+    }
+
+    static inline auto submit_by_key(
+        scheduler& sc, std::coroutine_handle<> handle, uint64_t key, task_priority prio = task_priority::normal) noexcept
+        -> void
+    {
+        sc.submit_by_key_impl(handle, key, prio);
+    }
+
+    static inline auto submit_to(
+        scheduler& sc, std::coroutine_handle<> handle, ctx_id id, task_priority prio = task_priority::normal) noexcept
+        -> void
+    {
+        sc.submit_to_id_impl(handle, id, prio);
     }
 
 private:
+    // only used by get_instance, the default instance is inited by static init later
+    scheduler() noexcept = default;
+
     static auto get_instance() noexcept -> scheduler*
     {
         static scheduler sc;
         return &sc;
     }
 
-    [[CORO_TEST_USED(lab2b)]] auto init_impl(size_t ctx_cnt) noexcept -> void;
+    /**
+     * @brief create one context per cpu list, only the first num_active contexts run at first
+     *
+     * @param cpu_lists
+     * @param num_active
+     */
+    [[CORO_TEST_USED(lab2b)]] auto init_impl(const std::vector<utils::cpu_list>& cpu_lists, size_t num_active) noexcept
+        -> void;
+
+    /**
+     * @brief return the cpus each context is pinned to by affinity strategy
+     *
+     * @param ctx_cnt
+     * @param aff
+     * @return std::vector<utils::cpu_list>, size is ctx_cnt
+     */
+    static auto plan_affinity(size_t ctx_cnt, detail::affinity_strategy aff) noexcept -> std::vector<utils::cpu_list>;
 
     [[CORO_TEST_USED(lab2b)]] auto loop_impl() noexcept -> void;
 
     auto stop_impl() noexcept -> void;
 
-    [[CORO_TEST_USED(lab2b)]] auto submit_task_impl(std::coroutine_handle<> handle) noexcept -> void;
+    auto start_long_run_impl() noexcept -> void;
+
+    /**
+     * @brief main logic of scaler thread, check the load of contexts every config::kScaleInterval
+     *
+     * @param token
+     */
+    auto scale_loop(std::stop_token token) noexcept -> void;
+
+    auto scale_tick() noexcept -> void;
+
+    auto shutdown_impl(std::chrono::steady_clock::time_point deadline) noexcept -> shutdown_report;
+
+    auto snapshot_stats_impl() noexcept -> scheduler_stats;
+
+    /**
+     * @brief handle tasks submitted after shutdown begins, tasks submitted by context are put
+     * into the submitter's own context which is still draining, others are rejected
+     *
+     * @param handles
+     * @param prio
+     */
+    auto reject_impl(std::span<const std::coroutine_handle<>> handles, task_priority prio) noexcept -> void;
+
+    [[CORO_TEST_USED(lab2b)]] auto submit_task_impl(std::coroutine_handle<> handle, task_priority prio) noexcept
+        -> void;
+
+    auto submit_batch_impl(std::span<const std::coroutine_handle<>> handles, task_priority prio) noexcept -> void;
+
+    auto submit_by_key_impl(std::coroutine_handle<> handle, uint64_t key, task_priority prio) noexcept -> void;
+
+    auto submit_to_id_impl(std::coroutine_handle<> handle, ctx_id id, task_priority prio) noexcept -> void;
+
+    /**
+     * @brief mark context ctx_id busy and submit task handle to it
+     *
+     * @param ctx_id
+     * @param handle
+     * @param prio
+     */
+    auto submit_to_ctx_impl(size_t ctx_id, std::coroutine_handle<> handle, task_priority prio) noexcept -> void;
+
+    /**
+     * @brief mark context ctx_id busy, so scheduler won't stop before its tasks finish
+     *
+     * @param ctx_id
+     */
+    auto mark_ctx_busy(size_t ctx_id) noexcept -> void;
 
     // TODO[lab2b]: Add more function if you need
     auto start_impl() noexcept -> void;
 
+    /**
+     * @brief used by work_stealing mode, let context thief steal tasks from
+     * the context which owns the most queued tasks
+     *
+     * @param thief
+     * @return true if any task is stolen
+     */
+    auto steal_impl(size_t thief) noexcept -> bool;
+
 private:
     size_t                                              m_ctx_cnt{0};
     detail::ctx_container                               m_ctxs;
@@ -106,25 +506,56 @@ private:
      */
     stop_flag_type  m_ctx_stop_flag;
 
+    // set by start() before contexts run, contexts never stop by themselves
+    // and submit skips the stop-token accounting, submitting threads read it
+    // concurrently with start()/shutdown(), so it is atomic
+    atomic<bool> m_long_run{false};
+
+    // contexts [0, m_num_active) accept new tasks, the rest are retired or never started,
+    // m_num_active is kept in [m_min_active, m_ctx_cnt] by scaler thread
+    atomic<size_t> m_num_active{0};
+    size_t         m_min_active{0};
+    std::jthread   m_scaler;
+
+    // below are only accessed by scaler thread, a context removed from dispatcher retires at
+    // the next tick, so scale up in between can take it back, submitters which still choose it
+    // after it retires are rejected by context::try_submit_task and dispatch again
+    static constexpr size_t kNoRetire = std::numeric_limits<size_t>::max();
+    size_t                  m_pending_retire{kNoRetire};
+    uint32_t                m_idle_ticks{0};
+    uint64_t                m_last_idle_time{0};
+    uint64_t                m_last_tick{0};
+
+    // cleared when shutdown begins, submissions from outside contexts are rejected then
+    atomic<bool>   m_accepting{true};
+    atomic<size_t> m_num_rejected{0};
+
+    // number of independent instances alive, global context and engine ids are only
+    // reset by init of the default instance when no independent instance is alive
+    inline static atomic<size_t> s_num_instance{0};
+
 #ifdef ENABLE_MEMORY_ALLOC
-    // Memory Allocator
+    // Memory Allocator, only the default instance owns it, coroutine frames may move
+    // between instances, so independent instances share the process-wide allocator
     coro::allocator::memory::memory_allocator<coro::config::kMemoryAllocator> m_mem_alloc;
 #endif
 };
 
-inline void submit_to_scheduler(task<void>&& task) noexcept
+// tasks submitted by the working thread of a scheduler instance stay in that instance
+
+inline void submit_to_scheduler(task<void>&& task, task_priority prio = task_priority::normal) noexcept
 {
-    scheduler::submit(std::move(task));
+    scheduler::submit(scheduler::current(), std::move(task), prio);
 }
 
-inline void submit_to_scheduler(task<void>& task) noexcept
+inline void submit_to_scheduler(task<void>& task, task_priority prio = task_priority::normal) noexcept
 {
-    scheduler::submit(task.handle());
+    scheduler::submit(scheduler::current(), task.handle(), prio);
 }
 
-inline void submit_to_scheduler(std::coroutine_handle<> handle) noexcept
+inline void submit_to_scheduler(std::coroutine_handle<> handle, task_priority prio = task_priority::normal) noexcept
 {
-    scheduler::submit(handle);
+    scheduler::submit(scheduler::current(), handle, prio);
 }
 
 }; // namespace coro
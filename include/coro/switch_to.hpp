@@ -0,0 +1,80 @@
+#pragma once
+
+#include <coroutine>
+
+#include "config.h"
+#include "coro/context.hpp"
+#include "coro/scheduler.hpp"
+
+namespace coro
+{
+namespace detail
+{
+/**
+ * @brief move the awaiting coroutine to the queue of context m_id, it resumes
+ * on the working thread of that context, m_id must belong to the current scheduler
+ *
+ */
+struct switch_to_awaiter
+{
+    auto await_ready() noexcept -> bool { return linfo.ctx != nullptr && local_context().get_ctx_id() == m_id; }
+
+    // 提交后协程可能立即在目标 context 上恢复，之后不能再访问 awaiter
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> void
+    {
+        scheduler::submit_to(scheduler::current(), handle, m_id, m_prio);
+    }
+
+    constexpr auto await_resume() noexcept -> void {}
+
+    ctx_id        m_id;
+    task_priority m_prio;
+};
+
+/**
+ * @brief move the awaiting coroutine to the context chosen by dispatcher
+ *
+ */
+struct switch_to_any_awaiter
+{
+    constexpr auto await_ready() noexcept -> bool { return false; }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> void
+    {
+        scheduler::submit(scheduler::current(), handle, m_prio);
+    }
+
+    constexpr auto await_resume() noexcept -> void {}
+
+    task_priority m_prio;
+};
+}; // namespace detail
+
+/**
+ * @brief move current coroutine to context id, usage: co_await coro::switch_to(scheduler::ctx_id_of(i));
+ * the coroutine continues on that context, it doesn't suspend if it already runs there
+ *
+ * @note useful for thread-per-core designs, each shard of data is only touched by its own context,
+ * but in work_stealing dispatch mode a queued coroutine may still be stolen by an idle context
+ *
+ * @param id
+ * @param prio priority class in the queue of target context
+ * @return detail::switch_to_awaiter
+ */
+inline auto switch_to(ctx_id id, task_priority prio = task_priority::normal) noexcept -> detail::switch_to_awaiter
+{
+    return {id, prio};
+}
+
+/**
+ * @brief move current coroutine to the context chosen by dispatcher, which may be current context
+ *
+ * @param prio priority class in the queue of target context
+ * @return detail::switch_to_any_awaiter
+ */
+inline auto switch_to_any(task_priority prio = task_priority::normal) noexcept -> detail::switch_to_any_awaiter
+{
+    return {prio};
+}
+
+}; // namespace coro
@@ -17,6 +17,7 @@
 
 #include "coro/attribute.hpp"
 #include "coro/detail/container.hpp"
+#include "coro/detail/types.hpp"
 
 #ifdef ENABLE_MEMORY_ALLOC
     #include "coro/meta_info.hpp"
@@ -106,11 +107,18 @@ public:
     auto continuation(std::coroutine_handle<> continuation) noexcept ->void{
         m_continuation=continuation;
     }
+
+    inline auto set_priority(task_priority prio) noexcept -> void { m_prio = prio; }
+    inline auto get_priority() const noexcept -> task_priority { return m_prio; }
 public:
     coro_state m_state{coro_state::normal};
 
 private:
     std::coroutine_handle<> m_continuation{nullptr};
+
+    // priority class the coroutine was last submitted with, io callbacks and waits
+    // resume the coroutine with it, awaited child tasks inherit it from their parent
+    task_priority m_prio{task_priority::normal};
 };
 
 template<typename return_type>
@@ -187,6 +195,28 @@ private:
     std::exception_ptr m_exception_ptr{nullptr};
 };
 
+/**
+ * @brief return the priority class recorded in the promise of handle
+ *
+ * @param handle must be the handle of a task
+ * @return task_priority
+ */
+inline auto get_priority(std::coroutine_handle<> handle) noexcept -> task_priority
+{
+    return std::coroutine_handle<promise_base>::from_address(handle.address()).promise().get_priority();
+}
+
+/**
+ * @brief record the priority class in the promise of handle, so the coroutine keeps it across suspensions
+ *
+ * @param handle must be the handle of a task
+ * @param prio
+ */
+inline auto set_priority(std::coroutine_handle<> handle, task_priority prio) noexcept -> void
+{
+    std::coroutine_handle<promise_base>::from_address(handle.address()).promise().set_priority(prio);
+}
+
 } // namespace detail
 
 template<typename return_type>
@@ -207,6 +237,7 @@ public:
         {
             // TODO[lab1]: Add you codes
             m_coroutine.promise().continuation(awaiting_coroutine);
+            m_coroutine.promise().set_priority(detail::get_priority(awaiting_coroutine));
             return m_coroutine;
         }
 
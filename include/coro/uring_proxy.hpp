@@ -6,6 +6,7 @@
 #include <functional>
 #include <liburing.h>
 #include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <vector>
 // #ifdef ENABLE_SQPOOL
 //     #include <time.h>
@@ -41,7 +42,15 @@ public:
         }
     }
 
-    ~uring_proxy() noexcept = default;
+    // eventfd lives as long as the proxy, so it stays valid across deinit and init of a restarted engine
+    ~uring_proxy() noexcept
+    {
+        if (m_efd >= 0)
+        {
+            close(m_efd);
+            m_efd = -1;
+        }
+    }
 
     auto init(unsigned int entry_length) noexcept -> void
     {
@@ -60,11 +69,16 @@ public:
             std::exit(1);
         }
 
-        res = io_uring_register_eventfd(&m_uring, m_efd);
-        if (res != 0)
+        // in submit_and_wait poll strategy eventfd is read by uring itself, if it's also registered,
+        // every cqe will write eventfd and then complete the read again
+        if constexpr (config::kPollStrategy == coro::detail::poll_strategy::eventfd)
         {
-            log::error("uring_proxy bind event_fd to uring failed");
-            std::exit(1);
+            res = io_uring_register_eventfd(&m_uring, m_efd);
+            if (res != 0)
+            {
+                log::error("uring_proxy bind event_fd to uring failed");
+                std::exit(1);
+            }
         }
 
         if constexpr (config::kEnableFixfd)
@@ -97,10 +111,26 @@ public:
 
     auto deinit() noexcept -> void
     {
+        if (m_fixed_buf_pool != nullptr)
+        {
+            io_uring_unregister_buffers(&m_uring);
+            std::free(m_fixed_buf_pool);
+            m_fixed_buf_pool = nullptr;
+            m_fixed_buf_free.clear();
+        }
+        m_fixed_buf_failed = false;
+        if (m_buf_ring != nullptr)
+        {
+            io_uring_free_buf_ring(&m_uring, m_buf_ring, config::kBufRingEntries, config::kBufRingGroupId);
+            std::free(m_buf_pool);
+            m_buf_ring = nullptr;
+            m_buf_pool = nullptr;
+        }
+        m_buf_ring_failed = false;
+
         // this operation cost too much time, so don't call this function
         // io_uring_unregister_eventfd(&m_uring);
-        close(m_efd);
-        m_efd = -1;
+        // eventfd is closed by destructor, a late write from other threads after deinit is harmless
 
         if constexpr (config::kEnableFixfd)
         {
@@ -178,6 +208,88 @@ public:
         return io_uring_submit(&m_uring);
     }
 
+    /**
+     * @brief submit all sqe entry and wait at least wait_nr cqe entry in one syscall
+     *
+     * @note block function
+     *
+     * @param wait_nr
+     * @param timeout_ms 0 means no timeout
+     * @return int the number of submitted sqe entry, or negative errno such as -ETIME
+     */
+    inline auto submit_and_wait(unsigned int wait_nr, unsigned int timeout_ms = 0) noexcept -> int CORO_INLINE
+    {
+        urcptr cqe;
+        if (timeout_ms == 0)
+        {
+            return io_uring_submit_and_wait_timeout(&m_uring, &cqe, wait_nr, nullptr, nullptr);
+        }
+        __kernel_timespec ts{.tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000LL};
+        return io_uring_submit_and_wait_timeout(&m_uring, &cqe, wait_nr, &ts, nullptr);
+    }
+
+    /**
+     * @brief return the number of sqe entry which are prepared but not consumed by kernel yet,
+     * sqe entry left by a failed submit stays in submission queue and is submitted next time
+     *
+     * @return unsigned int
+     */
+    inline auto num_sqe_ready() noexcept -> unsigned int CORO_INLINE { return io_uring_sq_ready(&m_uring); }
+
+    /**
+     * @brief return the position of the sqe entry which get_free_sqe returns next,
+     * positions increase monotonically and wrap around
+     *
+     * @return unsigned int
+     */
+    inline auto sqe_tail() noexcept -> unsigned int CORO_INLINE { return m_uring.sq.sqe_tail; }
+
+    /**
+     * @brief return if the sqe entry at position pos has been consumed by kernel,
+     * kernel consumes sqe entry in the order they are prepared
+     *
+     * @param pos
+     * @return true
+     * @return false
+     */
+    inline auto is_sqe_consumed(unsigned int pos) noexcept -> bool CORO_INLINE
+    {
+        auto head = m_uring.sq.sqe_tail - io_uring_sq_ready(&m_uring);
+        return static_cast<int>(head - pos) > 0;
+    }
+
+    /**
+     * @brief return the position of sqe entry if it has been returned by get_free_sqe but not
+     * handed to kernel by submit yet, search starts from the last one, -1 if not found
+     *
+     * @param sqe
+     * @return int64_t
+     */
+    inline auto pending_sqe_pos(ursptr sqe) noexcept -> int64_t
+    {
+        auto& sq = m_uring.sq;
+        for (unsigned int pos = sq.sqe_tail; pos != sq.sqe_head;)
+        {
+            pos--;
+            if (&sq.sqes[pos & sq.ring_mask] == sqe)
+            {
+                return pos;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * @brief prepare a read of eventfd in sqe, so the write of eventfd will produce a cqe entry
+     *
+     * @param sqe
+     * @param buf receive the value of eventfd
+     */
+    inline auto prep_read_eventfd(ursptr sqe, uint64_t* buf) noexcept -> void CORO_INLINE
+    {
+        io_uring_prep_read(sqe, m_efd, buf, sizeof(uint64_t), 0);
+    }
+
     /**
      * @brief use io_uring_for_each_cqe to process cqe entry
      *
@@ -284,6 +396,156 @@ public:
         }
     }
 
+    /**
+     * @brief register the provided buffer ring and put all buffers into it,
+     * only the first call does the work, a failed setup is not retried until deinit
+     *
+     * @return true if the ring is ready
+     */
+    auto init_buf_ring() noexcept -> bool
+    {
+        static_assert((config::kBufRingEntries & (config::kBufRingEntries - 1)) == 0 && config::kBufRingEntries <= 32768,
+                      "kBufRingEntries must be power of 2 and no more than 32768");
+        if (m_buf_ring != nullptr) [[likely]]
+        {
+            return true;
+        }
+        if (m_buf_ring_failed)
+        {
+            return false;
+        }
+
+        int ret    = 0;
+        m_buf_ring = io_uring_setup_buf_ring(&m_uring, config::kBufRingEntries, config::kBufRingGroupId, 0, &ret);
+        if (m_buf_ring == nullptr)
+        {
+            log::error("uring_proxy setup buf ring failed, result: {}", ret);
+            m_buf_ring_failed = true;
+            return false;
+        }
+        m_buf_pool = static_cast<char*>(std::malloc(size_t(config::kBufRingEntries) * config::kBufRingBufSize));
+        assert(m_buf_pool != nullptr && "buf ring pool alloc failed");
+
+        auto mask = io_uring_buf_ring_mask(config::kBufRingEntries);
+        for (unsigned int i = 0; i < config::kBufRingEntries; i++)
+        {
+            io_uring_buf_ring_add(m_buf_ring, get_buf(i), config::kBufRingBufSize, i, mask, i);
+        }
+        io_uring_buf_ring_advance(m_buf_ring, config::kBufRingEntries);
+        return true;
+    }
+
+    /**
+     * @brief return the address of buffer bid in provided buffer ring
+     *
+     * @param bid buffer id carried by cqe flags
+     * @return char*
+     */
+    inline auto get_buf(uint16_t bid) noexcept -> char* CORO_INLINE
+    {
+        return m_buf_pool + size_t(bid) * config::kBufRingBufSize;
+    }
+
+    /**
+     * @brief give buffer bid back to provided buffer ring, so kernel can pick it again
+     *
+     * @param bid
+     */
+    inline auto recycle_buf(uint16_t bid) noexcept -> void CORO_INLINE
+    {
+        io_uring_buf_ring_add(
+            m_buf_ring, get_buf(bid), config::kBufRingBufSize, bid, io_uring_buf_ring_mask(config::kBufRingEntries), 0);
+        io_uring_buf_ring_advance(m_buf_ring, 1);
+    }
+
+    /**
+     * @brief register the buffer pool, all buffers are free after it,
+     * a failed registration is not retried until deinit
+     *
+     * @return true if the pool is ready
+     */
+    auto init_fixed_bufs() noexcept -> bool
+    {
+        static_assert(config::kFixedBufSize % 4096 == 0, "kFixedBufSize must be multiple of 4096");
+        if (m_fixed_buf_pool != nullptr)
+        {
+            return true;
+        }
+        if (m_fixed_buf_failed)
+        {
+            return false;
+        }
+
+        auto total = size_t(config::kFixedBufNum) * config::kFixedBufSize;
+        auto pool  = static_cast<char*>(std::aligned_alloc(4096, total));
+        assert(pool != nullptr && "fixed buffer pool alloc failed");
+
+        std::vector<iovec> iovs(config::kFixedBufNum);
+        for (unsigned int i = 0; i < config::kFixedBufNum; i++)
+        {
+            iovs[i].iov_base = pool + size_t(i) * config::kFixedBufSize;
+            iovs[i].iov_len  = config::kFixedBufSize;
+        }
+        auto res = io_uring_register_buffers(&m_uring, iovs.data(), config::kFixedBufNum);
+        if (res != 0)
+        {
+            log::error("uring_proxy register buffers failed, result: {}", res);
+            std::free(pool);
+            m_fixed_buf_failed = true;
+            return false;
+        }
+
+        m_fixed_buf_pool = pool;
+        m_fixed_buf_free.reserve(config::kFixedBufNum);
+        for (int i = config::kFixedBufNum - 1; i >= 0; i--)
+        {
+            m_fixed_buf_free.push_back(i);
+        }
+        return true;
+    }
+
+    /**
+     * @brief lease one buffer of the registered buffer pool, the pool is registered at the first call
+     *
+     * @return int the buffer index used by read_fixed/write_fixed, -1 if all buffers are leased
+     * or the pool can't be registered
+     */
+    auto lease_fixed_buf() noexcept -> int
+    {
+        if (m_fixed_buf_pool == nullptr) [[unlikely]]
+        {
+            if (!init_fixed_bufs())
+            {
+                return -1;
+            }
+        }
+        if (m_fixed_buf_free.empty())
+        {
+            return -1;
+        }
+        auto idx = m_fixed_buf_free.back();
+        m_fixed_buf_free.pop_back();
+        return idx;
+    }
+
+    /**
+     * @brief return back the leased buffer
+     *
+     * @param idx
+     */
+    inline auto return_fixed_buf(int idx) noexcept -> void CORO_INLINE { m_fixed_buf_free.push_back(idx); }
+
+    /**
+     * @brief return the address of registered buffer idx
+     *
+     * @param idx
+     * @return char*
+     */
+    inline auto get_fixed_buf(int idx) noexcept -> char* CORO_INLINE
+    {
+        return m_fixed_buf_pool + size_t(idx) * config::kFixedBufSize;
+    }
+
 private:
     int             m_efd{0};
     io_uring_params m_para;
@@ -292,6 +554,18 @@ private:
     // Use m_fds to utilize the IOSQE_FIXED_FILE feature of io_uring
     std::vector<int>                                            m_null_fds;
     ::coro::detail::marked_buffer<int, config::kFixFdArraySize> m_fds;
+
+    // registered buffer pool and the indexes of free buffers, registered lazily by lease_fixed_buf
+    char*            m_fixed_buf_pool{nullptr};
+    std::vector<int> m_fixed_buf_free;
+    // set when registration fails, such as RLIMIT_MEMLOCK is too low, so every lease fails at once
+    bool m_fixed_buf_failed{false};
+
+    // provided buffer ring and the memory of its buffers, registered lazily by init_buf_ring
+    io_uring_buf_ring* m_buf_ring{nullptr};
+    char*              m_buf_pool{nullptr};
+    // set when setup fails, such as the kernel doesn't support buffer ring, so it isn't retried
+    bool m_buf_ring_failed{false};
 };
 
 }; // namespace coro::uring
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <regex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace coro::utils
 {
@@ -22,6 +23,40 @@ auto set_fd_noblock(int fd) noexcept -> void;
  */
 auto get_null_fd() noexcept -> int;
 
+// cpu ids, used to describe the cpus a thread can run on
+using cpu_list = std::vector<int>;
+
+/**
+ * @brief return the cpus current process is allowed to run on
+ *
+ * @return cpu_list
+ */
+auto get_allowed_cpus() noexcept -> cpu_list;
+
+/**
+ * @brief return allowed cpus grouped by numa node, nodes without allowed cpu are skipped,
+ * if numa info is unavailable, all allowed cpus are treated as one node
+ *
+ * @return std::vector<cpu_list>
+ */
+auto get_numa_cpus() noexcept -> std::vector<cpu_list>;
+
+/**
+ * @brief parse cpu list string in the format of linux sysfs, such as "0-3,8,10-11"
+ *
+ * @param s
+ * @return cpu_list
+ */
+auto parse_cpu_list(const std::string& s) noexcept -> cpu_list;
+
+/**
+ * @brief pin current thread to cpus
+ *
+ * @param cpus
+ * @return true if success
+ */
+auto set_thread_affinity(const cpu_list& cpus) noexcept -> bool;
+
 inline auto sleep(int64_t t) noexcept -> void
 {
     std::this_thread::sleep_for(std::chrono::seconds(t));
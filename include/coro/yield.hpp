@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+
+#include "config.h"
+#include "coro/engine.hpp"
+
+namespace coro
+{
+namespace detail
+{
+/**
+ * @brief requeue the awaiting coroutine to the tail of local engine, so other tasks
+ * and finished io of this engine get processed before it resumes
+ *
+ */
+struct yield_awaiter
+{
+    constexpr auto await_ready() noexcept -> bool { return false; }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> void { local_engine().yield_task(handle); }
+
+    constexpr auto await_resume() noexcept -> void {}
+};
+
+/**
+ * @brief same as yield_awaiter, but only yields when m_yield is true
+ *
+ */
+struct yield_if_awaiter
+{
+    auto await_ready() noexcept -> bool { return !m_yield; }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> void { local_engine().yield_task(handle); }
+
+    constexpr auto await_resume() noexcept -> void {}
+
+    bool m_yield;
+};
+}; // namespace detail
+
+/**
+ * @brief give the context back to other tasks, usage: co_await coro::yield();
+ *
+ * @return detail::yield_awaiter
+ */
+inline auto yield() noexcept -> detail::yield_awaiter
+{
+    return {};
+}
+
+/**
+ * @brief auto yield helper for cpu heavy loops, the coroutine yields only when
+ * the operation budget or time slice is used up, usage:
+ *
+ * yield_budget budget;
+ * for (...)
+ * {
+ *     work();
+ *     co_await budget.consume();
+ * }
+ *
+ */
+class yield_budget
+{
+    using clock = std::chrono::steady_clock;
+
+public:
+    /**
+     * @brief Construct a new yield budget object
+     *
+     * @param max_ops yield after consuming max_ops operations
+     * @param max_time yield after running max_time since last yield, 0 means no time limit
+     */
+    explicit yield_budget(
+        size_t max_ops = config::kYieldBudget, std::chrono::microseconds max_time = std::chrono::microseconds{0}) noexcept
+        : m_max_ops(max_ops),
+          m_max_time(max_time),
+          m_start(max_time.count() > 0 ? clock::now() : clock::time_point{})
+    {
+    }
+
+    /**
+     * @brief consume ops operations of budget, co_await the return value to yield
+     * when the budget is used up, then the budget is refilled
+     *
+     * @param ops
+     * @return detail::yield_if_awaiter
+     */
+    auto consume(size_t ops = 1) noexcept -> detail::yield_if_awaiter
+    {
+        m_used += ops;
+        bool timeout = m_max_time.count() > 0 && clock::now() - m_start >= m_max_time;
+        if (m_used < m_max_ops && !timeout)
+        {
+            return {false};
+        }
+
+        m_used = 0;
+        if (m_max_time.count() > 0)
+        {
+            m_start = clock::now();
+        }
+        return {true};
+    }
+
+private:
+    size_t                    m_max_ops;
+    size_t                    m_used{0};
+    std::chrono::microseconds m_max_time;
+    clock::time_point         m_start;
+};
+
+}; // namespace coro
@@ -31,7 +31,7 @@ auto event_base::resume_all_awaiters(awaiter_ptr waiter) noexcept ->void{
     while(waiter!=nullptr){
         auto cur=static_cast<awaiter_base*> (waiter);//转换后才能访问 awaiter_base 特有的成员
         auto next = cur->m_next;
-        cur->m_ctx.submit_task(cur->m_await_coro);// 提交协程到对应 context
+        cur->m_ctx.submit_task(cur->m_await_coro, get_priority(cur->m_await_coro));// 提交协程到对应 context
         // 提交后协程可能立即执行完毕并析构 awaiter，此时 cur 已无效
         // waiter=cur->next();
         waiter = next;
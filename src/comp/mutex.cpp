@@ -52,7 +52,7 @@ auto mutex::mutex_awaiter::register_lock() noexcept -> bool{
 
 auto mutex::mutex_awaiter::resume() noexcept -> void
 {
-    m_ctx.submit_task(m_await_coro);
+    m_ctx.submit_task(m_await_coro, detail::get_priority(m_await_coro));
     // m_ctx.unregister_wait();
     // m_register_state = true;
 }
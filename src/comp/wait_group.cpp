@@ -49,7 +49,7 @@ auto wait_group::awaiter::await_resume() noexcept -> void
  */
 auto wait_group::awaiter::resume() noexcept -> void
 {
-    m_ctx.submit_task(m_await_coro);
+    m_ctx.submit_task(m_await_coro, detail::get_priority(m_await_coro));
 }
 
 auto wait_group::add(int count) noexcept -> void
@@ -1,4 +1,8 @@
+#include <algorithm>
+
 #include "coro/context.hpp"
+#include "coro/log.hpp"
+#include "coro/offload.hpp"
 #include "coro/scheduler.hpp"
 
 //每个 context 对应一个工作线程：调度器可以创建多个 context，实现多线程并发
@@ -27,23 +31,52 @@ auto context::deinit() noexcept -> void
     m_engine.deinit();
 }
 
+/// engine 计数器与 context 计数器合并，各项逐个读取
+auto context::get_stats() noexcept -> context_stats
+{
+    context_stats stats;
+    static_cast<detail::engine_stats&>(stats) = m_engine.get_stats();
+    stats.id              = m_id;
+    stats.num_wait_task   = m_num_wait_task.load(memory_order_acquire);
+    stats.num_steal       = m_num_steal.load(memory_order_relaxed);
+    stats.max_task_queued = m_max_task_queued.load(memory_order_relaxed);
+    return stats;
+}
+
 /// 启动工作线程：创建新线程执行 init -> run -> deinit 流程
 /// @note 此函数立即返回，不会阻塞调用者
 auto context::start() noexcept -> void
 {
     // TODO[lab2b]: Add you codes
     // 创建 jthread，lambda 捕获 this 指针以访问成员函数
-    // jthread 会自动传入 stop_token 用于协作式停止
-    m_job = make_unique<jthread>(
-        [this](stop_token token)
+    // 停止信号由 m_stop_src 发出而非 jthread 自带的 stop_source：
+    // 工作线程可能在 m_job 赋值完成前就执行完所有任务并请求停止
+    m_force_stop.store(false, memory_order_relaxed);
+    m_retire.store(false, memory_order_relaxed);
+    m_accepting.store(true, memory_order_relaxed);
+    m_finished.store(false, memory_order_relaxed);
+    m_num_cancelled_task = 0;
+    m_num_cancelled_io   = 0;
+
+    m_stop_src = stop_source{};
+    m_job      = make_unique<jthread>(
+        [this, token = m_stop_src.get_token()]()
         {
+            // 先绑核再初始化，使 io_uring 以及线程首次访问的内存分配在本地 numa 节点
+            if (!m_cpus.empty() && !utils::set_thread_affinity(m_cpus))
+            {
+                log::warn("context {} set cpu affinity failed", m_id);
+            }
             this->init();         // 初始化当前线程的 context
             // 如果外部没有注入 stop_cb，那么自行为其添加逻辑
             if(!(this->m_stop_cb)){
-                m_stop_cb=[&](){m_job->request_stop();}; // 请求线程停止
+                m_stop_cb=[&](){m_stop_src.request_stop();}; // 请求线程停止
             }
             this->run(token);     // 主循环，token 用于检测是否需要停止
+            // 持锁清理，停止请求不会在 deinit 过程中写入 eventfd
+            std::lock_guard<std::mutex> lock(m_exit_mtx);
             this->deinit();       // 清理
+            m_finished.store(true, std::memory_order_release);
         });
 }
 
@@ -51,17 +84,82 @@ auto context::start() noexcept -> void
 auto context::notify_stop() noexcept -> void
 {
     // TODO[lab2b]: Add you codes
-    m_job->request_stop();  // 设置 stop_token，使 token.stop_requested() 返回 true
+    // 工作线程未运行时无需唤醒，deinit 期间也不能唤醒
+    std::lock_guard<std::mutex> lock(m_exit_mtx);
+    if (m_finished.load(memory_order_acquire))
+    {
+        return;
+    }
+    m_stop_src.request_stop();  // 设置 stop_token，使 token.stop_requested() 返回 true
     m_engine.wake_up(1);    // 唤醒可能在等待 IO 的 engine
 }
 
+/// 退役工作线程：排队中的任务交给 m_migrate_cb 迁出，剩余 IO 与等待完成后线程退出
+auto context::retire() noexcept -> void
+{
+    std::lock_guard<std::mutex> lock(m_exit_mtx);
+    if (m_finished.load(memory_order_acquire))
+    {
+        return;
+    }
+    // 先拒绝新的调度提交，工作线程迁出任务前会等待已通过检查的提交者完成入队
+    m_accepting.store(false, std::memory_order_seq_cst);
+    m_retire.store(true, std::memory_order_release);
+    m_stop_src.request_stop();
+    m_engine.wake_up(1);
+}
+
+/// 强制停止工作线程：不再等待任务与 IO 完成，排队中的任务被丢弃
+auto context::force_stop() noexcept -> void
+{
+    std::lock_guard<std::mutex> lock(m_exit_mtx);
+    if (m_finished.load(memory_order_acquire))
+    {
+        return;
+    }
+    m_force_stop.store(true, std::memory_order_release);
+    m_stop_src.request_stop();
+    m_engine.wake_up(1);
+}
+
 /// 提交协程任务到当前 context 的 engine
-auto context::submit_task(std::coroutine_handle<> handle) noexcept -> void
+auto context::submit_task(std::coroutine_handle<> handle, task_priority prio) noexcept -> void
 {
     // TODO[lab2b]: Add you codes
-    m_engine.submit_task(handle);
+    m_engine.submit_task(handle, prio);
+}
+
+/// 批量提交协程任务到当前 context 的 engine
+auto context::submit_batch(std::span<const std::coroutine_handle<>> handles, task_priority prio) noexcept -> void
+{
+    m_engine.submit_batch(handles, prio);
 }
 
+/// 退役开始后拒绝调度提交：提交者先登记再检查 m_accepting，与 retire 的先清标志、
+/// 工作线程后等待登记数归零构成握手，通过检查的任务一定在迁出前入队
+auto context::try_submit_task(std::coroutine_handle<> handle, task_priority prio) noexcept -> bool
+{
+    m_num_submitting.fetch_add(1, std::memory_order_seq_cst);
+    bool accepted = m_accepting.load(std::memory_order_seq_cst);
+    if (accepted)
+    {
+        m_engine.submit_task(handle, prio);
+    }
+    m_num_submitting.fetch_sub(1, std::memory_order_release);
+    return accepted;
+}
+
+auto context::try_submit_batch(std::span<const std::coroutine_handle<>> handles, task_priority prio) noexcept -> bool
+{
+    m_num_submitting.fetch_add(1, std::memory_order_seq_cst);
+    bool accepted = m_accepting.load(std::memory_order_seq_cst);
+    if (accepted)
+    {
+        m_engine.submit_batch(handles, prio);
+    }
+    m_num_submitting.fetch_sub(1, std::memory_order_release);
+    return accepted;
+}
 
 /// 增加等待任务计数（原子操作，线程安全）
 auto context::register_wait(int register_cnt) noexcept -> void
@@ -81,8 +179,38 @@ auto context::process_work() noexcept -> void
 {
     // TODO[lab2b]: Add you codes
     auto num=m_engine.num_task_schedule();
+    if (num > m_max_task_queued.load(memory_order_relaxed))
+    {
+        m_max_task_queued.store(num, memory_order_relaxed);
+    }
+    // 每轮执行的任务数与时间都有上限，剩余任务留到下一轮，避免任务突发时 IO 长时间得不到处理
+    if constexpr (config::kMaxTaskPerTurn > 0)
+    {
+        num = std::min(num, config::kMaxTaskPerTurn);
+    }
+    uint64_t start = 0;
+    if constexpr (config::kTurnTimeBudget > 0)
+    {
+        start = detail::engine::steady_now_ns();
+    }
     for(size_t i=0;i<num;i++){
         m_engine.exec_one_task();
+        if constexpr (config::kIoFlushInterval > 0)
+        {
+            // 中途提交任务发起的 IO，使其与后续任务的执行重叠
+            if ((i + 1) % config::kIoFlushInterval == 0)
+            {
+                m_engine.do_io_submit();
+            }
+        }
+        if constexpr (config::kTurnTimeBudget > 0)
+        {
+            if ((i + 1) % config::kTurnTimeCheck == 0
+                && detail::engine::steady_now_ns() - start >= uint64_t(config::kTurnTimeBudget) * 1000)
+            {
+                break;
+            }
+        }
     }
 
 }
@@ -141,6 +269,30 @@ auto context::run(stop_token token) noexcept -> void
     // 新实现：
     while (true)
     {
+        // 0. 强制停止与退役都会请求停止，只在收到停止信号后检查
+        if (token.stop_requested()) [[unlikely]]
+        {
+            // 被强制停止时丢弃排队中的任务，取消剩余 IO 后退出
+            if (m_force_stop.load(memory_order_acquire))
+            {
+                m_num_cancelled_task = m_engine.cancel_all_tasks();
+                m_num_cancelled_io   = m_engine.num_io();
+                // deinit 前内核不能再持有 io_info 指针，等待被取消的 IO 全部完成
+                cancel_io();
+                // offload 线程池中的任务完成后不能再提交到 deinit 后的 context，
+                // 之后再丢弃放弃等待 IO 时以及 offload 完成时被恢复而留在队列中的协程
+                m_num_cancelled_task += detail::offload_pool::get_instance()->cancel(this);
+                m_num_cancelled_task += m_engine.cancel_all_tasks();
+                m_num_cancelled_io += m_num_wait_task.load(memory_order_acquire);
+                break;
+            }
+            // 退役时先把排队中的任务迁出，之后被唤醒的任务仍在本 context 执行
+            if (m_retire.exchange(false, memory_order_acq_rel) && m_migrate_cb)
+            {
+                migrate_tasks();
+            }
+        }
+
         // 1. 处理所有就绪的任务
         process_work();
 
@@ -156,7 +308,13 @@ auto context::run(stop_token token) noexcept -> void
             break;
         }
 
-        // 3. 没有收到停止信号时，检查是否空闲
+        // 3. 任务队列为空时，先尝试从其他忙碌的 context 窃取任务再阻塞等待
+        if (!m_engine.ready() && m_steal_cb && m_steal_cb())
+        {
+            detail::engine::stat_add(m_num_steal, 1);
+        }
+
+        // 4. 没有收到停止信号时，检查是否空闲
         if (!token.stop_requested() && empty_wait_work() && !m_engine.ready())
         {
             // 空闲了，通知 scheduler（如果有回调的话）
@@ -164,14 +322,75 @@ auto context::run(stop_token token) noexcept -> void
             {
                 m_stop_cb();
             }
+            // stop_cb 可能已经请求本线程停止，此时不能再阻塞等待 eventfd
+            if (token.stop_requested())
+            {
+                continue;
+            }
         }
 
-        // 4. 等待/处理 IO
+        // 5. 等待/处理 IO
+        poll_work();
+    }
+}
+
+/// 取消所有 IO 并等待其完成：对应协程以 -ECANCELED 恢复并执行，
+/// 协程在此期间发起的 IO 在上次取消请求之后提交，需要再次取消，直到 engine 中没有 IO 与任务
+/// 协程收到 -ECANCELED 后可能不断重新发起 IO，取消轮数超过 kMaxCancelRound 后放弃等待，
+/// 剩余 IO 交给 io_uring 销毁时处理，避免 shutdown 越过截止时间后无限阻塞
+auto context::cancel_io() noexcept -> void
+{
+    bool   cancel    = !m_engine.empty_io();
+    size_t num_round = 0;
+    while (!m_engine.empty_io() || m_engine.ready())
+    {
+        if (cancel)
+        {
+            if (num_round++ == config::kMaxCancelRound)
+            {
+                log::warn("context {} gives up cancelling io after {} rounds", m_id, config::kMaxCancelRound);
+                return;
+            }
+            m_engine.cancel_all_io();
+        }
         poll_work();
+        process_work();
+        cancel = m_engine.m_num_io_wait_submit > 0;
+    }
+}
+
+/// 等待已通过 m_accepting 检查的提交者完成入队后再迁出任务，之后的调度提交都会被拒绝
+/// 先取出全部任务再交给回调：scheduler 关闭时回调会把任务提交回本 context，边取边交会反复取到它们
+auto context::migrate_tasks() noexcept -> void
+{
+    while (m_num_submitting.load(std::memory_order_seq_cst) > 0)
+    {
+        std::this_thread::yield();
+    }
+    std::vector<std::pair<std::coroutine_handle<>, task_priority>> tasks;
+    m_engine.drain_tasks([&tasks](std::coroutine_handle<> handle, task_priority prio)
+                         { tasks.emplace_back(handle, prio); });
+    for (auto [handle, prio] : tasks)
+    {
+        m_migrate_cb(handle, prio);
     }
 }
 
 auto context::set_stop_cb(stop_cb cb) noexcept -> void{
     m_stop_cb=cb;
 }
+
+auto context::set_steal_cb(steal_cb cb) noexcept -> void{
+    m_steal_cb=cb;
+}
+
+auto context::set_migrate_cb(migrate_cb cb) noexcept -> void
+{
+    m_migrate_cb = cb;
+}
+
+auto context::set_cpu_affinity(utils::cpu_list cpus) noexcept -> void
+{
+    m_cpus = std::move(cpus);
+}
 }; // namespace coro
\ No newline at end of file
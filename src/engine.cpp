@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cerrno>
+
 #include "coro/engine.hpp"
 #include "coro/io/io_info.hpp"
 #include "coro/task.hpp"
@@ -20,12 +23,44 @@ auto engine::init() noexcept -> void
 auto engine::deinit() noexcept -> void
 {
     // TODO[lab2a]: Add you codes
+    if (linfo.egn == this)
+    {
+        // 避免线程局部变量指向已销毁的 engine，同地址的新 engine 会被误判为本线程所有
+        linfo.egn = nullptr;
+    }
     m_upxy.deinit();
     m_num_io_running=0;
     m_num_io_wait_submit=0;
     mpmc_queue<coroutine_handle<>> task_queue;  // 1. 创建一个空的临时队列
     m_task_queue.swap(task_queue);               // 2. 交换：m_task_queue 变空，task_queue 拿走原数据
                                                  // 3. 函数结束时，task_queue 析构，原数据被释放
+    m_overflow_queue.clear();
+    m_pinned_queue.clear();
+    for (auto& que : m_prio_queue)
+    {
+        que.clear();
+    }
+    m_num_task_run.fill(0);
+    m_high_prio_streak = 0;
+    m_cqe_ready_head    = 0;
+    m_num_cqe_ready     = 0;
+    m_num_inline_resume = 0;
+    m_reaping           = false;
+    m_cqe_backlog       = false;
+    m_run_next        = nullptr;
+    m_local_head      = 0;
+    m_local_tail      = 0;
+    m_run_next_streak = 0;
+    m_sched_tick      = 0;
+    m_sleeping.store(false, memory_order_relaxed);
+    // 队列与 IO 计数已清空，重新发布使负载和统计中的当前值归零
+    publish_load();
+    m_efd_armed  = false;
+    m_efd_queued = false;
+    m_idle_avg       = 0;
+    m_spin_budget    = uint64_t(config::kBusyPollMinTime) * 1000;
+    m_num_spin_hit   = 0;
+    m_num_spin_sleep = 0;
 }
 
 /// 检查是否有待调度的任务
@@ -33,7 +68,7 @@ auto engine::deinit() noexcept -> void
 auto engine::ready() noexcept -> bool
 {
     // TODO[lab2a]: Add you codes
-    return !m_task_queue.was_empty();
+    return num_local_task() > 0 || has_shared_task();
 }
 
 /// 获取一个空闲的 io_uring SQE（提交队列条目）
@@ -48,19 +83,232 @@ auto engine::get_free_urs() noexcept -> ursptr
 auto engine::num_task_schedule() noexcept -> size_t
 {
     // TODO[lab2a]: Add you codes
-    return m_task_queue.was_size();
+    return num_local_task() + m_task_queue.was_size() + m_overflow_queue.was_size() + num_prio_task() +
+           m_pinned_queue.was_size();
 }
 
 /// 从任务队列中取出一个协程句柄
-/// @return 待执行的协程句柄
+/// 优先级：高优先级 > 普通优先级 > 低优先级，高优先级连续执行 kMaxHighPrioStreak 次后让出一次，
+/// 每 kLowPrioCheckInterval 次调度优先检查一次低优先级队列
+/// @return 待执行的协程句柄，队列中的任务被其他 engine 窃取时返回 nullptr
 auto engine::schedule() noexcept -> coroutine_handle<>
 {
     // TODO[lab2a]: Add you codes
-    auto coro=m_task_queue.pop();
-    assert(bool(coro));
+    coroutine_handle<> coro{nullptr};
+    ++m_sched_tick;
+    if (m_high_prio_streak < config::kMaxHighPrioStreak && pop_prio_task(task_priority::high, coro))
+    {
+        m_high_prio_streak++;
+        return coro;
+    }
+    m_high_prio_streak = 0;
+
+    // 固定在本 engine 恢复的协程（如 offload 完成的协程）先于普通任务执行，不经过可被窃取的共享队列
+    if (m_pinned_queue.try_pop(coro))
+    {
+        m_num_task_run[static_cast<size_t>(task_priority::normal)]++;
+        return coro;
+    }
+
+    if (m_sched_tick % config::kLowPrioCheckInterval == 0 && pop_prio_task(task_priority::low, coro))
+    {
+        return coro;
+    }
+
+    coro = schedule_normal();
+    if (coro)
+    {
+        m_num_task_run[static_cast<size_t>(task_priority::normal)]++;
+        return coro;
+    }
+
+    // 没有普通任务时执行低优先级任务，高优先级任务可能因让出而仍有剩余
+    if (pop_prio_task(task_priority::low, coro) || pop_prio_task(task_priority::high, coro))
+    {
+        return coro;
+    }
+    return nullptr;
+}
+
+/// 从高优先级或低优先级队列取出一个协程句柄并计数
+auto engine::pop_prio_task(task_priority prio, coroutine_handle<>& handle) noexcept -> bool
+{
+    if (m_prio_queue[static_cast<size_t>(prio)].try_pop(handle))
+    {
+        m_num_task_run[static_cast<size_t>(prio)]++;
+        return true;
+    }
+    return false;
+}
+
+/// 取出一个普通优先级的协程句柄
+/// 优先级：run-next 槽 > 本地缓冲区 > 共享队列，每 kSharedQueCheckInterval 次调度优先检查一次共享队列
+auto engine::schedule_normal() noexcept -> coroutine_handle<>
+{
+    coroutine_handle<> coro{nullptr};
+    if constexpr (config::kInlineCqeResume)
+    {
+        // IO 刚完成的协程最先执行，此时 IO 结果仍在缓存中
+        coro = pop_cqe_ready();
+        if (coro)
+        {
+            return coro;
+        }
+    }
+    if (m_sched_tick % config::kSharedQueCheckInterval == 0 && pop_shared_task(coro))
+    {
+        return coro;
+    }
+
+    if (m_run_next)
+    {
+        if (m_run_next_streak < config::kMaxRunNextStreak)
+        {
+            m_run_next_streak++;
+            return std::exchange(m_run_next, nullptr);
+        }
+        // run-next 槽被连续占用过多次，将其降级到本地缓冲区，避免饿死其他任务
+        push_local_task(std::exchange(m_run_next, nullptr));
+    }
+    m_run_next_streak = 0;
+
+    coro = pop_local_task();
+    if (!coro)
+    {
+        pop_shared_task(coro);
+    }
     return coro;
 }
 
+/// 将协程句柄放入共享队列，共享队列已满时放入溢出队列
+/// 溢出队列非空时新任务也必须进入溢出队列，保证共享任务整体先进先出
+auto engine::push_shared_task(coroutine_handle<> handle) noexcept -> void
+{
+    if (m_overflow_queue.was_empty() && m_task_queue.try_push(handle))
+    {
+        return;
+    }
+    m_overflow_queue.push(handle);
+}
+
+/// 先从共享队列取任务，共享队列为空时再从溢出队列取
+auto engine::pop_shared_task(coroutine_handle<>& handle) noexcept -> bool
+{
+    return m_task_queue.try_pop(handle) || m_overflow_queue.try_pop(handle);
+}
+
+/// 将协程句柄放入本地缓冲区，缓冲区满时溢出到共享队列
+auto engine::push_local_task(coroutine_handle<> handle) noexcept -> void
+{
+    if (m_local_tail - m_local_head < config::kLocalQueCap)
+    {
+        m_local_que[m_local_tail++ % config::kLocalQueCap] = handle;
+    }
+    else
+    {
+        // 当前线程正在运行，无需写 eventfd 唤醒
+        push_shared_task(handle);
+    }
+}
+
+/// 按 config::kScheduleStrategy 从本地缓冲区取出一个协程句柄
+auto engine::pop_local_task() noexcept -> coroutine_handle<>
+{
+    if (m_local_head == m_local_tail)
+    {
+        return nullptr;
+    }
+    if constexpr (config::kScheduleStrategy == schedule_strategy::lifo)
+    {
+        return m_local_que[--m_local_tail % config::kLocalQueCap];
+    }
+    else
+    {
+        return m_local_que[m_local_head++ % config::kLocalQueCap];
+    }
+}
+
+/// 由 engine 所属线程提交任务：新任务占据 run-next 槽，原 run-next 任务放入本地缓冲区
+auto engine::submit_local_task(coroutine_handle<> handle) noexcept -> void
+{
+    if (m_run_next)
+    {
+        push_local_task(std::exchange(m_run_next, handle));
+    }
+    else
+    {
+        m_run_next = handle;
+    }
+}
+
+/// 批量提交协程任务，整批任务最多写一次 eventfd
+auto engine::submit_batch(std::span<const coroutine_handle<>> handles, task_priority prio) noexcept -> void
+{
+    assert(prio < task_priority::none && "engine get invalid task priority");
+    if (handles.empty())
+    {
+        return;
+    }
+    for (auto handle : handles)
+    {
+        set_priority(handle, prio);
+    }
+
+    if (prio != task_priority::normal)
+    {
+        m_prio_queue[static_cast<size_t>(prio)].push_batch(handles.data(), handles.size());
+    }
+    else if (linfo.egn == this)
+    {
+        // 整批任务不经过 run-next 槽，否则每次提交都会将前一个任务挤出
+        for (auto handle : handles)
+        {
+            push_local_task(handle);
+        }
+        return;
+    }
+    else
+    {
+        for (auto handle : handles)
+        {
+            push_shared_task(handle);
+        }
+    }
+
+    if (linfo.egn != this)
+    {
+        wake_up_if_sleeping();
+    }
+}
+
+/// 让出执行权的协程重新入队：不占用 run-next 槽，排在已入队的任务之后，所属线程正在运行无需写 eventfd
+auto engine::yield_task(coroutine_handle<> handle) noexcept -> void
+{
+    assert(linfo.egn == this && "yield task to engine not owned by current thread");
+    if constexpr (config::kScheduleStrategy == schedule_strategy::lifo)
+    {
+        // lifo 模式下本地缓冲区尾部的任务最先执行，放入共享队列才能真正让出
+        push_shared_task(handle);
+    }
+    else
+    {
+        push_local_task(handle);
+    }
+}
+
+/// 提交必须在本 engine 执行的协程：放入单独的队列，steal_from 与 drain_tasks 都不会取出它
+auto engine::submit_pinned_task(coroutine_handle<> handle, task_priority prio) noexcept -> void
+{
+    assert(handle != nullptr && "engine get nullptr task handle");
+    assert(prio < task_priority::none && "engine get invalid task priority");
+    set_priority(handle, prio);
+    m_pinned_queue.push(handle);
+    if (linfo.egn != this)
+    {
+        wake_up_if_sleeping();
+    }
+}
+
 /// 唤醒可能阻塞在 eventfd 上的 engine
 /// @param val 写入 eventfd 的值
 auto engine::wake_up(uint64_t val)noexcept->void{
@@ -69,66 +317,432 @@ auto engine::wake_up(uint64_t val)noexcept->void{
 
 /// 提交一个协程任务到任务队列，并唤醒 engine
 /// @param handle 协程句柄
-auto engine::submit_task(coroutine_handle<> handle) noexcept -> void
+/// @param prio 任务优先级，高优先级和低优先级任务进入各自的队列
+auto engine::submit_task(coroutine_handle<> handle, task_priority prio) noexcept -> void
 {
     // TODO[lab2a]: Add you codes
     assert(handle != nullptr && "engine get nullptr task handle");
-    m_task_queue.push(handle);
-    wake_up(task_flag);//自动生成的参数
+    assert(prio < task_priority::none && "engine get invalid task priority");
+    // 记录到 promise 中，IO 回调与等待唤醒按该优先级重新入队
+    set_priority(handle, prio);
+    if (prio != task_priority::normal)
+    {
+        m_prio_queue[static_cast<size_t>(prio)].push(handle);
+        if (linfo.egn != this)
+        {
+            wake_up_if_sleeping();
+        }
+        return;
+    }
+    if (linfo.egn == this)
+    {
+        if constexpr (config::kInlineCqeResume)
+        {
+            // IO 回调唤醒的协程暂存到就绪环中，下一次调度时最先执行，不经过本地缓冲区
+            if (m_reaping && m_num_cqe_ready < m_cqe_ready.size())
+            {
+                m_cqe_ready[(m_cqe_ready_head + m_num_cqe_ready++) % m_cqe_ready.size()] = handle;
+                return;
+            }
+        }
+        // 所属线程提交任务时该线程一定处于运行状态，无需原子操作和 eventfd 唤醒
+        submit_local_task(handle);
+        return;
+    }
+    push_shared_task(handle);
+    wake_up_if_sleeping();
+}
+
+/// 仅当所属线程声明即将阻塞在 eventfd 上时才写 eventfd，多个生产者只有一个会真正写入
+auto engine::wake_up_if_sleeping() noexcept -> void
+{
+    // 与 poll_submit 中的 fence 配对：要么所属线程在阻塞前看到新任务，要么这里看到 m_sleeping 为 true
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(memory_order_relaxed) && m_sleeping.exchange(false, std::memory_order_acq_rel))
+    {
+        wake_up(task_flag);
+    }
+}
+
+/// 从 victim 的任务队列窃取一半任务（不超过 max_num）并提交到当前 engine
+/// @return 窃取到的任务数量
+auto engine::steal_from(engine& victim, size_t max_num) noexcept -> size_t
+{
+    auto num = std::min((victim.num_task_stealable() + 1) / 2, max_num);
+
+    size_t             stolen = 0;
+    coroutine_handle<> coro{nullptr};
+    while (stolen < num && victim.pop_shared_task(coro))
+    {
+        push_shared_task(coro);
+        stolen++;
+    }
+    // 无需唤醒：poll_submit 阻塞前会再次检查共享队列
+    return stolen;
 }
 
 /// 执行一个任务：从队列取出协程并恢复执行，若完成则清理
 auto engine::exec_one_task() noexcept -> void
 {
     auto coro = schedule();
+    if (!coro)
+    {
+        return;
+    }
     coro.resume();
+    stat_add(m_stats.num_task_exec, 1);
     if (coro.done())
     {
         clean(coro);
     }
 }
 
+/// 各计数器只由所属线程写入，读取时逐个加载，运行中的 engine 返回的各项之间可能略有偏差
+auto engine::get_stats() noexcept -> engine_stats
+{
+    engine_stats stats;
+    stats.num_task_exec      = m_stats.num_task_exec.load(memory_order_relaxed);
+    stats.num_cqe            = m_stats.num_cqe.load(memory_order_relaxed);
+    stats.num_wakeup         = m_stats.num_wakeup.load(memory_order_relaxed);
+    stats.idle_time          = idle_time();
+    stats.num_io_running     = m_stats.num_io_running.load(memory_order_relaxed);
+    stats.num_io_wait_submit = m_stats.num_io_wait_submit.load(memory_order_relaxed);
+    stats.num_task_queued =
+        m_stats.num_local_task.load(memory_order_relaxed) + num_task_stealable() + num_prio_task();
+    return stats;
+}
+
+/// 按高、普通、低优先级的顺序取出所有排队的任务交给 fn，用于将任务迁出即将退役的 context
+auto engine::drain_tasks(const std::function<void(coroutine_handle<>, task_priority)>& fn) noexcept -> size_t
+{
+    size_t             num = 0;
+    coroutine_handle<> coro{nullptr};
+    while (pop_prio_task(task_priority::high, coro))
+    {
+        fn(coro, task_priority::high);
+        num++;
+    }
+    for (coro = schedule_normal(); coro; coro = schedule_normal())
+    {
+        fn(coro, task_priority::normal);
+        num++;
+    }
+    while (pop_prio_task(task_priority::low, coro))
+    {
+        fn(coro, task_priority::low);
+        num++;
+    }
+    return num;
+}
+
+/// 取出并丢弃所有排队的任务，被 detach 的任务按 clean() 的语义销毁
+auto engine::cancel_all_tasks() noexcept -> size_t
+{
+    size_t num = 0;
+    while (ready())
+    {
+        // 队列中的任务可能被其他 engine 窃取，此时 schedule 返回 nullptr
+        auto coro = schedule();
+        if (coro)
+        {
+            clean(coro);
+            num++;
+        }
+    }
+    return num;
+}
+
+/// 准备一个匹配 uring 中任意请求的取消请求，被取消的 IO 以 -ECANCELED 完成，回调照常执行
+/// 取消请求本身计入 IO，其 cqe 在 reap_cqe 中跳过回调
+auto engine::cancel_all_io() noexcept -> void
+{
+    auto sqe = get_free_urs();
+    if (sqe == nullptr)
+    {
+        // sq 已满，先提交腾出空间
+        do_io_submit();
+        sqe = get_free_urs();
+    }
+    assert(sqe != nullptr && "engine get nullptr sqe when cancelling io");
+    io_uring_prep_cancel(sqe, nullptr, IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_ANY);
+    io_uring_sqe_set_data(sqe, &m_cancel_tag);
+    add_io_submit();
+}
+
 /// 处理一个已完成的 CQE（完成队列条目）
 /// @param cqe 指向完成队列条目的指针
 auto engine::handle_cqe_entry(urcptr cqe) noexcept -> void
 {
-    auto data = reinterpret_cast<io::detail::io_info*>(io_uring_cqe_get_data(cqe));
+    auto data       = reinterpret_cast<io::detail::io_info*>(io_uring_cqe_get_data(cqe));
+    data->cqe_flags = cqe->flags;
     data->cb(data, cqe->res);
 }
 
 /// 执行 IO 提交：将等待提交的 IO 请求批量提交到内核
 auto engine::do_io_submit() noexcept -> void
 {
-    if(m_num_io_wait_submit>0){
-        auto _ = m_upxy.submit();
-        m_num_io_running+=m_num_io_wait_submit;
-        m_num_io_wait_submit=0;
+    if (m_num_io_wait_submit > 0 || m_efd_queued)
+    {
+        settle_io_submit(m_upxy.submit());
+    }
+}
+
+/// 按提交队列中剩余的 sqe 结算 IO 计数：提交出错时 sqe 不会被内核消费，仍计为待提交，下次轮询重试
+auto engine::settle_io_submit(int ret) noexcept -> void
+{
+    if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY && ret != -ETIME) [[unlikely]]
+    {
+        log::warn("engine {} submit io failed, result: {}", m_id, ret);
+    }
+#ifdef ENABLE_SQPOOL
+    // sq 线程异步消费 sqe，提交成功即视为全部提交
+    size_t left = ret < 0 ? m_num_io_wait_submit : 0;
+    if (ret >= 0)
+    {
+        m_efd_queued = false;
+    }
+#else
+    size_t left = m_upxy.num_sqe_ready();
+    if (m_efd_queued)
+    {
+        // eventfd 读请求不计入 IO 计数，内核按准备顺序消费 sqe，由其位置判断是否已提交
+        if (m_upxy.is_sqe_consumed(m_efd_sqe_pos))
+        {
+            m_efd_queued = false;
+        }
+        else
+        {
+            left--;
+        }
     }
+    left = std::min(left, m_num_io_wait_submit);
+#endif
+    m_num_io_running += m_num_io_wait_submit - left;
+    m_num_io_wait_submit = left;
 }
 
 /// IO 轮询主函数：提交 IO、等待 IO 完成、处理已完成的 IO
 auto engine::poll_submit() noexcept -> void
 {
     // TODO[lab2a]: Add you codes
+    publish_load();
+    if constexpr (config::kPollStrategy == poll_strategy::submit_and_wait)
+    {
+        poll_submit_and_wait();
+        return;
+    }
+
     do_io_submit();
+    if (num_local_task() > 0 || m_cqe_backlog || m_num_io_wait_submit > 0)
+    {
+        // 本地任务不会写 eventfd，提交失败的 IO 也不会产生 cqe，此时不能阻塞，只处理已完成的 IO
+        reap_cqe();
+        return;
+    }
+
+    if (busy_poll())
+    {
+        // cqe 已写入 eventfd 的计数只会导致下一次 wait 提前返回
+        reap_cqe();
+        return;
+    }
+
+    // 声明即将睡眠后再检查一次共享队列，避免与只在睡眠时才写 eventfd 的生产者产生丢失唤醒
+    m_sleeping.store(true, memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (has_shared_task())
+    {
+        // 生产者可能已经写入 eventfd，残留的计数只会导致下一次 wait 提前返回
+        m_sleeping.store(false, memory_order_relaxed);
+        reap_cqe();
+        return;
+    }
+    begin_idle();
     auto cnt=m_upxy.wait_eventfd();
+    m_sleeping.store(false, memory_order_relaxed);
+    end_idle();
+    end_busy_poll();
     if(!wake_by_cqe(cnt)){
         return;
     }
-    //这句代码中的load是原子操作，但是m_num_io_running是size_t类型，engine只在单线程内，不需要原子操作保证线程安全
+    reap_cqe();
+}
+
+/// submit_and_wait 模式的 IO 轮询：提交 IO 与等待完成合并为一次 io_uring_enter
+/// 任务唤醒通过 uring 中常驻的 eventfd 读请求以 cqe 的形式到达
+auto engine::poll_submit_and_wait() noexcept -> void
+{
+    if (num_local_task() > 0 || m_cqe_backlog)
+    {
+        do_io_submit();
+        reap_cqe();
+        return;
+    }
+
+    if constexpr (config::kBusyPollMaxTime > 0)
+    {
+        // 自旋前必须先提交 IO，否则自旋期间 IO 不会开始执行
+        do_io_submit();
+        if (busy_poll())
+        {
+            reap_cqe();
+            return;
+        }
+    }
+
+    if (!m_efd_armed)
+    {
+        auto sqe = m_upxy.get_free_sqe();
+        if (sqe == nullptr)
+        {
+            // sq 已满，先提交腾出空间
+            do_io_submit();
+            sqe = m_upxy.get_free_sqe();
+        }
+        assert(sqe != nullptr && "engine get nullptr sqe when arming eventfd read");
+        m_upxy.prep_read_eventfd(sqe, &m_efd_buf);
+        io_uring_sqe_set_data(sqe, &m_efd_buf);
+        m_efd_armed   = true;
+        m_efd_queued  = true;
+        m_efd_sqe_pos = m_upxy.sqe_tail() - 1;
+    }
+
+    // 与 eventfd 模式相同的睡眠协议，生产者仍通过写 eventfd 唤醒
+    m_sleeping.store(true, memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (has_shared_task())
+    {
+        m_sleeping.store(false, memory_order_relaxed);
+        do_io_submit();
+        reap_cqe();
+        return;
+    }
+    begin_idle();
+    // 提交失败（如 -EINTR）时不会等待，未提交的 sqe 由下次轮询重新提交
+    settle_io_submit(m_upxy.submit_and_wait(1, config::kPollWaitTimeout));
+    m_sleeping.store(false, memory_order_relaxed);
+    end_idle();
+    end_busy_poll();
+    reap_cqe();
+}
+
+/// 睡眠前自旋检查 cq 与共享任务队列，自旋时长由 m_spin_budget 限制
+/// @return true 表示自旋期间有 IO 完成或任务到达，无需睡眠
+auto engine::busy_poll() noexcept -> bool
+{
+    if constexpr (config::kBusyPollMaxTime == 0)
+    {
+        return false;
+    }
+
+    using clock  = std::chrono::steady_clock;
+    m_idle_start = clock::now();
+    auto deadline = m_idle_start + std::chrono::nanoseconds(m_spin_budget);
+    do
+    {
+        if (has_shared_task() || m_upxy.peek_uring())
+        {
+            m_num_spin_hit++;
+            end_busy_poll();
+            return true;
+        }
+        // 按架构选择 pause/yield 指令
+        atomic_queue::spin_loop_pause();
+    } while (clock::now() < deadline);
+
+    m_num_spin_sleep++;
+    return false;
+}
+
+/// 根据最近的空闲时长调整自旋预算：空闲时长较短时自旋大概率能等到工作，
+/// 预算设为平均空闲时长的两倍；空闲时长超过上限时自旋只是浪费 CPU，预算退回下限
+auto engine::end_busy_poll() noexcept -> void
+{
+    if constexpr (config::kBusyPollMaxTime == 0)
+    {
+        return;
+    }
+
+    constexpr uint64_t max_budget = uint64_t(config::kBusyPollMaxTime) * 1000;
+    constexpr uint64_t min_budget = std::min(uint64_t(config::kBusyPollMinTime) * 1000, max_budget);
+
+    uint64_t idle = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - m_idle_start).count();
+    m_idle_avg    = m_idle_avg == 0 ? idle : (m_idle_avg * 7 + idle) / 8;
+    m_spin_budget = m_idle_avg <= max_budget ? std::clamp(m_idle_avg * 2, min_budget, max_budget) : min_budget;
+}
+
+/// 非阻塞地处理所有已完成的 IO
+auto engine::reap_cqe() noexcept -> void
+{
+    // 这句代码中的load是原子操作，但是m_num_io_running是size_t类型，engine只在单线程内，不需要原子操作保证线程安全
     // auto num = m_upxy.peek_batch_cqe(m_urc.data(), m_num_io_running.load(std::memory_order_acquire));
-    auto num=m_upxy.peek_batch_cqe(m_urc.data(),m_num_io_running);
-    if(num!=0){
-        for(size_t i=0;i<num;i++){
+    // multishot 请求的一个 sqe 可以产生多个 cqe，cqe 数量不受 m_num_io_running 限制
+    size_t max_num = m_urc.size();
+    if constexpr (config::kMaxCqePerTurn > 0)
+    {
+        max_num = std::min(max_num, config::kMaxCqePerTurn);
+    }
+    auto num = m_upxy.peek_batch_cqe(m_urc.data(), max_num);
+    // 本轮取满时 cq 中可能还有剩余，它们对应的 eventfd 计数已被读走，下次轮询不能阻塞等待
+    m_cqe_backlog = size_t(num) == max_num;
+    if (num != 0)
+    {
+        size_t num_io       = num;
+        size_t num_more     = 0;
+        size_t num_dispatch = 0;
+        m_reaping           = true;
+        for (size_t i = 0; i < num; i++)
+        {
+            if (m_efd_armed && is_wakeup_cqe(m_urc[i])) [[unlikely]]
+            {
+                // eventfd 读请求完成，下次睡眠前重新提交
+                m_efd_armed = false;
+                num_io--;
+                continue;
+            }
+            if (is_cancel_cqe(m_urc[i])) [[unlikely]]
+            {
+                // 取消请求完成，返回被取消的请求数，-ENOENT 表示没有匹配的请求
+                if (m_urc[i]->res < 0 && m_urc[i]->res != -ENOENT)
+                {
+                    log::warn("engine {} cancel io failed, result: {}", m_id, m_urc[i]->res);
+                }
+                continue;
+            }
+            // multishot 请求的中间 cqe 带有 IORING_CQE_F_MORE 标志，对应的 sqe 仍在运行
+            if (m_urc[i]->flags & IORING_CQE_F_MORE)
+            {
+                num_more++;
+            }
             handle_cqe_entry(m_urc[i]);
+            num_dispatch++;
         }
+        m_reaping = false;
         m_upxy.cq_advance(num);
-        //这句代码中的load是原子操作，但是m_num_io_running是size_t类型，engine只在单线程内，不需要原子操作保证线程安全
+        // 这句代码中的load是原子操作，但是m_num_io_running是size_t类型，engine只在单线程内，不需要原子操作保证线程安全
         // m_num_io_running.fetch_sub(num,std::memory_order_acq_rel);
-        m_num_io_running-=num;
+        m_num_io_running -= num_io - num_more;
+        // 内部的取消与唤醒 cqe 不计入统计，只统计交给 io_info 回调的 cqe
+        stat_add(m_stats.num_cqe, num_dispatch);
+        publish_load();
     }
 }
 
+/// 取出收割 cqe 期间暂存的协程，只有所属线程访问，无需同步
+auto engine::pop_cqe_ready() noexcept -> coroutine_handle<>
+{
+    if (m_num_cqe_ready == 0)
+    {
+        return nullptr;
+    }
+    auto coro        = m_cqe_ready[m_cqe_ready_head];
+    m_cqe_ready_head = (m_cqe_ready_head + 1) % m_cqe_ready.size();
+    m_num_cqe_ready--;
+    m_num_inline_resume++;
+    return coro;
+}
+
 /// 增加待提交 IO 计数（调用此函数后需调用 do_io_submit 实际提交）
 auto engine::add_io_submit() noexcept -> void
 {
@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <optional>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include "coro/io/io_awaiter.hpp"
+#include "coro/log.hpp"
 #include "coro/scheduler.hpp"
 
 namespace coro::io
@@ -10,6 +12,121 @@ namespace coro::io
 using ::coro::detail::local_engine;
 using detail::io_type;
 
+auto detail::base_io_awaiter::timeout(std::chrono::nanoseconds duration) noexcept -> linked_timeout_awaiter
+{
+    return linked_timeout_awaiter(*this, duration);
+}
+
+detail::linked_timeout_awaiter::linked_timeout_awaiter(base_io_awaiter& io, std::chrono::nanoseconds duration) noexcept
+    : m_io(io)
+{
+    auto ns      = std::max<int64_t>(duration.count(), 0);
+    m_ts.tv_sec  = ns / 1000000000;
+    m_ts.tv_nsec = ns % 1000000000;
+}
+
+/// 在 await_suspend 中才准备 link timeout sqe：部分编译器（如 gcc 12）会把左值 awaiter 拷贝到协程帧中，
+/// 此时才能确定 awaiter 的最终地址。io sqe 带 IOSQE_IO_LINK 标志，紧随其后的 link timeout sqe 为其计时，
+/// 两个 sqe 各产生一个 cqe，都到达后才调用 io 原本的回调，避免协程恢复后 awaiter 仍被内核引用
+auto detail::linked_timeout_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept -> void
+{
+    m_io.await_suspend(handle);
+
+    m_io_data             = m_io.m_info.data;
+    m_io_cb               = m_io.m_info.cb;
+    m_timeout_info.type   = io_type::timer;
+    m_timeout_info.cb     = &linked_timeout_awaiter::timeout_callback;
+    m_timeout_info.data   = CASTPTR(this);
+    m_timeout_info.result = 0;
+    m_io.m_info.data      = CASTPTR(this);
+    m_io.m_info.cb        = &linked_timeout_awaiter::io_callback;
+
+    // io sqe 必须仍在提交队列中且是最后准备的 sqe，否则下一个 sqe 无法与其链接
+    auto& upxy = local_engine().get_uring();
+    auto  pos  = upxy.pending_sqe_pos(m_io.m_urs);
+    if (pos < 0 || static_cast<unsigned int>(pos) + 1 != upxy.sqe_tail()) [[unlikely]]
+    {
+        fail_link(-EINVAL, pos >= 0);
+        return;
+    }
+    auto sqe = local_engine().get_free_urs();
+    if (sqe == nullptr) [[unlikely]]
+    {
+        fail_link(-EBUSY, true);
+        return;
+    }
+
+    m_num_wait = 2;
+    m_io.m_urs->flags |= IOSQE_IO_LINK;
+    io_uring_prep_link_timeout(sqe, &m_ts, 0);
+    io_uring_sqe_set_data(sqe, &m_timeout_info);
+    local_engine().add_io_submit();
+}
+
+/// io 无法链接超时：内核尚未取走 io sqe 时将其改为 nop，io 不会执行；
+/// 已提交的 io 无法撤回，只能等其完成，两种情况都在最后一个 cqe 到达后返回 res
+auto detail::linked_timeout_awaiter::fail_link(int res, bool pending) noexcept -> void
+{
+    log::warn("io can't be linked to timeout, co_await the awaiter right after timeout is set, result: {}", res);
+    m_fail_res = res;
+    m_num_wait = 1;
+    if (pending)
+    {
+        // prep 会重置 sqe 的 flags，但不保证保留 user data，重新设置
+        io_uring_prep_nop(m_io.m_urs);
+        io_uring_sqe_set_data(m_io.m_urs, &m_io.m_info);
+    }
+}
+
+auto detail::linked_timeout_awaiter::io_callback(io_info* data, int res) noexcept -> void
+{
+    auto self = reinterpret_cast<linked_timeout_awaiter*>(data->data);
+    if (data->cqe_flags & IORING_CQE_F_MORE)
+    {
+        // 零拷贝发送的第一个 cqe 携带发送结果，超时取消时其结果为 -ECANCELED，先记录下来
+        self->m_io_res = res;
+        return;
+    }
+    // 之后的通知 cqe 只表示内核不再引用缓冲区，结果仍取第一个 cqe 的
+    if (!(data->cqe_flags & IORING_CQE_F_NOTIF))
+    {
+        self->m_io_res = res;
+    }
+    // 原回调只会收到一个不带 F_MORE 与 F_NOTIF 的 cqe，据此记录结果并恢复协程
+    self->m_io_cqe_flags = data->cqe_flags & ~IORING_CQE_F_NOTIF;
+    self->finish();
+}
+
+auto detail::linked_timeout_awaiter::timeout_callback(io_info* data, int res) noexcept -> void
+{
+    auto self                   = reinterpret_cast<linked_timeout_awaiter*>(data->data);
+    self->m_timeout_info.result = res;
+    self->finish();
+}
+
+auto detail::linked_timeout_awaiter::finish() noexcept -> void
+{
+    if (--m_num_wait > 0)
+    {
+        return;
+    }
+
+    // 超时触发时 io 以 -ECANCELED（部分操作为 -EINTR）结束，统一返回 -ETIME
+    auto res = m_io_res;
+    if (m_fail_res != 0)
+    {
+        res = m_fail_res;
+    }
+    else if (m_timeout_info.result == -ETIME && (res == -ECANCELED || res == -EINTR))
+    {
+        res = -ETIME;
+    }
+    m_io.m_info.data      = m_io_data;
+    m_io.m_info.cb        = m_io_cb;
+    m_io.m_info.cqe_flags = m_io_cqe_flags;
+    m_io.m_info.cb(&m_io.m_info, res);
+}
+
 noop_awaiter::noop_awaiter() noexcept
 {
     m_info.type = io_type::nop;
@@ -43,6 +160,43 @@ auto stdin_awaiter::callback(io_info* data, int res) noexcept -> void
     submit_to_context(data->handle);
 }
 
+read_fixed_awaiter::read_fixed_awaiter(
+    int fd, char* buf, size_t len, int buf_index, uint64_t offset, int sqe_flag) noexcept
+{
+    m_info.type = io_type::read_fixed;
+    m_info.cb   = &read_fixed_awaiter::callback;
+
+    io_uring_prep_read_fixed(m_urs, fd, buf, len, offset, buf_index);
+    // prep 会清空 sqe->flags，需要在其后设置
+    io_uring_sqe_set_flags(m_urs, sqe_flag);
+    io_uring_sqe_set_data(m_urs, &m_info);
+    local_engine().add_io_submit();
+}
+
+auto read_fixed_awaiter::callback(io_info* data, int res) noexcept -> void
+{
+    data->result = res;
+    submit_to_context(data->handle);
+}
+
+write_fixed_awaiter::write_fixed_awaiter(
+    int fd, char* buf, size_t len, int buf_index, uint64_t offset, int sqe_flag) noexcept
+{
+    m_info.type = io_type::write_fixed;
+    m_info.cb   = &write_fixed_awaiter::callback;
+
+    io_uring_prep_write_fixed(m_urs, fd, buf, len, offset, buf_index);
+    io_uring_sqe_set_flags(m_urs, sqe_flag);
+    io_uring_sqe_set_data(m_urs, &m_info);
+    local_engine().add_io_submit();
+}
+
+auto write_fixed_awaiter::callback(io_info* data, int res) noexcept -> void
+{
+    data->result = res;
+    submit_to_context(data->handle);
+}
+
 namespace net
 {
 /**
@@ -103,6 +257,67 @@ auto tcp_write_awaiter::callback(io_info* data, int res) noexcept -> void
     submit_to_context(data->handle);
 }
 
+tcp_send_zc_awaiter::tcp_send_zc_awaiter(int sockfd, char* buf, size_t len, int io_flag, int sqe_flag) noexcept
+{
+    m_info.type = io_type::tcp_send_zc;
+    m_info.cb   = &tcp_send_zc_awaiter::callback;
+
+    // 小数据量时拷贝比锁定用户页的开销更低
+    if (len < ::coro::config::kSendZcThreshold)
+    {
+        io_uring_prep_send(m_urs, sockfd, buf, len, io_flag);
+    }
+    else
+    {
+        io_uring_prep_send_zc(m_urs, sockfd, buf, len, io_flag, 0);
+    }
+    // prep 会清空 sqe->flags，需要在其后设置
+    io_uring_sqe_set_flags(m_urs, sqe_flag);
+    io_uring_sqe_set_data(m_urs, &m_info);
+    local_engine().add_io_submit();
+}
+
+/// 零拷贝发送会产生两个 cqe：第一个带 IORING_CQE_F_MORE 标志，携带发送结果；
+/// 第二个带 IORING_CQE_F_NOTIF 标志，表示内核不再引用缓冲区，此时才能恢复协程
+auto tcp_send_zc_awaiter::callback(io_info* data, int res) noexcept -> void
+{
+    if (data->cqe_flags & IORING_CQE_F_NOTIF)
+    {
+        submit_to_context(data->handle);
+        return;
+    }
+    data->result = res;
+    if (!(data->cqe_flags & IORING_CQE_F_MORE))
+    {
+        // 回退为普通发送或发送失败时没有通知 cqe
+        submit_to_context(data->handle);
+    }
+}
+
+tcp_sendmsg_zc_awaiter::tcp_sendmsg_zc_awaiter(int sockfd, const msghdr* msg, int io_flag, int sqe_flag) noexcept
+{
+    m_info.type = io_type::tcp_send_zc;
+    m_info.cb   = &tcp_send_zc_awaiter::callback;
+
+    size_t len = 0;
+    for (size_t i = 0; i < msg->msg_iovlen; i++)
+    {
+        len += msg->msg_iov[i].iov_len;
+    }
+
+    if (len < ::coro::config::kSendZcThreshold)
+    {
+        io_uring_prep_sendmsg(m_urs, sockfd, msg, io_flag);
+    }
+    else
+    {
+        io_uring_prep_sendmsg_zc(m_urs, sockfd, msg, io_flag);
+    }
+    io_uring_sqe_set_flags(m_urs, sqe_flag);
+    io_uring_sqe_set_data(m_urs, &m_info);
+    local_engine().add_io_submit();
+}
+
 tcp_close_awaiter::tcp_close_awaiter(int sockfd) noexcept
 {
     m_info.type = io_type::tcp_close;
@@ -1,4 +1,6 @@
+#include <cerrno>
 #include <cstdlib>
+#include <utility>
 
 #include "coro/io/net/tcp/tcp.hpp"
 #include "coro/log.hpp"
@@ -41,6 +43,15 @@ tcp_server::tcp_server(const char* addr, int port) noexcept
         std::exit(1);
     }
 
+    // port 0 lets kernel choose a free port, read it back
+    socklen_t len = sizeof(m_servaddr);
+    if (getsockname(m_listenfd, (sockaddr*)&m_servaddr, &len) != 0)
+    {
+        log::error("server getsockname error");
+        std::exit(1);
+    }
+    m_port = ntohs(m_servaddr.sin_port);
+
     m_sqe_flag = 0;
     m_fixed_fd.assign(m_listenfd, m_sqe_flag);
 }
@@ -50,6 +61,254 @@ tcp_accept_awaiter tcp_server::accept(int io_flags) noexcept
     return tcp_accept_awaiter(m_listenfd, io_flags, m_sqe_flag);
 }
 
+tcp_accept_stream tcp_server::accept_stream(int io_flags) noexcept
+{
+    return tcp_accept_stream(m_listenfd, io_flags, m_sqe_flag);
+}
+
+tcp_accept_stream::tcp_accept_stream(int listenfd, int io_flag, int sqe_flag) noexcept
+    : m_listenfd(listenfd),
+      m_io_flag(io_flag),
+      m_sqe_flag(sqe_flag)
+{
+    m_info.type        = ::coro::io::detail::io_type::tcp_accept;
+    m_info.cb          = &tcp_accept_stream::accept_callback;
+    m_info.data        = CASTPTR(this);
+    m_cancel_info.type = ::coro::io::detail::io_type::none;
+    m_cancel_info.cb   = &tcp_accept_stream::cancel_callback;
+    m_cancel_info.data = CASTPTR(this);
+}
+
+tcp_accept_stream::~tcp_accept_stream() noexcept
+{
+    // 内核仍持有 m_info 的地址时析构会导致之后的 cqe 写入已释放的内存
+    assert(!m_armed && m_num_cancel_wait == 0 && "cancel accept stream before destroy it");
+    for (auto fd : m_fds)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+/// 提交 multishot accept 请求，之后每个新连接产生一个带 IORING_CQE_F_MORE 标志的 cqe
+auto tcp_accept_stream::arm() noexcept -> void
+{
+    auto sqe = ::coro::detail::local_engine().get_free_urs();
+    assert(sqe != nullptr && "io submit rate is too high");
+    io_uring_prep_multishot_accept(sqe, m_listenfd, nullptr, nullptr, m_io_flag);
+    io_uring_sqe_set_flags(sqe, m_sqe_flag);
+    io_uring_sqe_set_data(sqe, &m_info);
+    ::coro::detail::local_engine().add_io_submit();
+    m_armed = true;
+}
+
+auto tcp_accept_stream::accept_callback(io_info* data, int res) noexcept -> void
+{
+    auto stream = reinterpret_cast<tcp_accept_stream*>(data->data);
+    if (!(data->cqe_flags & IORING_CQE_F_MORE))
+    {
+        // 内核停止了 multishot（出错、被取消或 cq 溢出），下次 next 时重新提交
+        stream->m_armed = false;
+    }
+
+    if (stream->m_num_cancel_wait > 0)
+    {
+        // 取消过程中到达的连接直接关闭
+        if (res >= 0)
+        {
+            ::close(res);
+        }
+        if (!stream->m_armed)
+        {
+            stream->finish_cancel();
+        }
+        return;
+    }
+
+    // 最后一个 cqe 的错误只表示 multishot 停止，有等待者时才需要报告给它
+    if (stream->m_armed || res >= 0 || stream->m_waiter)
+    {
+        stream->m_fds.push_back(res);
+    }
+    if (stream->m_waiter)
+    {
+        submit_to_context(std::exchange(stream->m_waiter, nullptr));
+    }
+}
+
+auto tcp_accept_stream::cancel_callback(io_info* data, int res) noexcept -> void
+{
+    reinterpret_cast<tcp_accept_stream*>(data->data)->finish_cancel();
+}
+
+auto tcp_accept_stream::finish_cancel() noexcept -> void
+{
+    if (--m_num_cancel_wait == 0)
+    {
+        submit_to_context(std::exchange(m_cancel_waiter, nullptr));
+    }
+}
+
+auto tcp_accept_stream::next_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept -> void
+{
+    m_stream.m_waiter = handle;
+    if (!m_stream.m_armed)
+    {
+        m_stream.arm();
+    }
+}
+
+auto tcp_accept_stream::next_awaiter::await_resume() noexcept -> int
+{
+    auto fd = m_stream.m_fds.front();
+    m_stream.m_fds.pop_front();
+    return fd;
+}
+
+/// 提交取消请求，取消请求本身与 accept 的最后一个 cqe 都到达后才恢复协程
+auto tcp_accept_stream::cancel_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept -> void
+{
+    m_stream.m_cancel_waiter   = handle;
+    m_stream.m_num_cancel_wait = 2;
+
+    auto sqe = ::coro::detail::local_engine().get_free_urs();
+    assert(sqe != nullptr && "io submit rate is too high");
+    io_uring_prep_cancel(sqe, &m_stream.m_info, 0);
+    io_uring_sqe_set_data(sqe, &m_stream.m_cancel_info);
+    ::coro::detail::local_engine().add_io_submit();
+}
+
+tcp_recv_stream::tcp_recv_stream(int sockfd, int io_flag, int sqe_flag) noexcept
+    : m_sockfd(sockfd),
+      m_io_flag(io_flag),
+      m_sqe_flag(sqe_flag),
+      m_upxy(&::coro::detail::local_engine().get_uring())
+{
+    m_info.type        = ::coro::io::detail::io_type::tcp_read;
+    m_info.cb          = &tcp_recv_stream::recv_callback;
+    m_info.data        = CASTPTR(this);
+    m_cancel_info.type = ::coro::io::detail::io_type::none;
+    m_cancel_info.cb   = &tcp_recv_stream::cancel_callback;
+    m_cancel_info.data = CASTPTR(this);
+}
+
+tcp_recv_stream::~tcp_recv_stream() noexcept
+{
+    assert(!m_armed && m_num_cancel_wait == 0 && "cancel recv stream before destroy it");
+    for (size_t i = m_head; i < m_items.size(); i++)
+    {
+        if (m_items[i].bid >= 0)
+        {
+            m_upxy->recycle_buf(m_items[i].bid);
+        }
+    }
+}
+
+/// 提交 multishot recv 请求，由内核从 provided buffer ring 中挑选缓冲区，首次提交时才注册 buffer ring
+/// buffer ring 不可用时不提交，而是放入 -EOPNOTSUPP，否则调用方会不断收到 -ENOBUFS 并重试
+auto tcp_recv_stream::arm() noexcept -> bool
+{
+    if (!m_upxy->init_buf_ring()) [[unlikely]]
+    {
+        m_items.push_back({-EOPNOTSUPP, -1});
+        return false;
+    }
+
+    auto sqe = ::coro::detail::local_engine().get_free_urs();
+    assert(sqe != nullptr && "io submit rate is too high");
+    io_uring_prep_recv_multishot(sqe, m_sockfd, nullptr, 0, m_io_flag);
+    io_uring_sqe_set_flags(sqe, m_sqe_flag | IOSQE_BUFFER_SELECT);
+    sqe->buf_group = ::coro::config::kBufRingGroupId;
+    io_uring_sqe_set_data(sqe, &m_info);
+    ::coro::detail::local_engine().add_io_submit();
+    m_armed = true;
+    return true;
+}
+
+auto tcp_recv_stream::recv_callback(io_info* data, int res) noexcept -> void
+{
+    auto stream = reinterpret_cast<tcp_recv_stream*>(data->data);
+    int  bid    = (data->cqe_flags & IORING_CQE_F_BUFFER) ? int(data->cqe_flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    if (!(data->cqe_flags & IORING_CQE_F_MORE))
+    {
+        // 对端关闭、出错、buffer ring 为空（-ENOBUFS）或被取消时 multishot 停止，下次 next 时重新提交
+        stream->m_armed = false;
+    }
+
+    if (stream->m_num_cancel_wait > 0)
+    {
+        // 取消过程中收到的数据直接丢弃并归还缓冲区
+        if (bid >= 0)
+        {
+            stream->m_upxy->recycle_buf(bid);
+        }
+        if (!stream->m_armed)
+        {
+            stream->finish_cancel();
+        }
+        return;
+    }
+
+    stream->m_items.push_back({res, bid});
+    if (stream->m_waiter)
+    {
+        submit_to_context(std::exchange(stream->m_waiter, nullptr));
+    }
+}
+
+auto tcp_recv_stream::cancel_callback(io_info* data, int res) noexcept -> void
+{
+    reinterpret_cast<tcp_recv_stream*>(data->data)->finish_cancel();
+}
+
+auto tcp_recv_stream::finish_cancel() noexcept -> void
+{
+    if (--m_num_cancel_wait == 0)
+    {
+        submit_to_context(std::exchange(m_cancel_waiter, nullptr));
+    }
+}
+
+auto tcp_recv_stream::next_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept -> bool
+{
+    if (!m_stream.m_armed && !m_stream.arm())
+    {
+        // 提交失败时错误已放入队列，不挂起直接返回
+        return false;
+    }
+    m_stream.m_waiter = handle;
+    return true;
+}
+
+auto tcp_recv_stream::next_awaiter::await_resume() noexcept -> tcp_recv_buffer
+{
+    auto item = m_stream.m_items[m_stream.m_head++];
+    if (m_stream.m_head == m_stream.m_items.size())
+    {
+        m_stream.m_items.clear();
+        m_stream.m_head = 0;
+    }
+    if (item.bid < 0)
+    {
+        return tcp_recv_buffer(item.res, nullptr, 0, m_stream.m_upxy);
+    }
+    return tcp_recv_buffer(item.res, m_stream.m_upxy->get_buf(item.bid), item.bid, m_stream.m_upxy);
+}
+
+auto tcp_recv_stream::cancel_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept -> void
+{
+    m_stream.m_cancel_waiter   = handle;
+    m_stream.m_num_cancel_wait = 2;
+
+    auto sqe = ::coro::detail::local_engine().get_free_urs();
+    assert(sqe != nullptr && "io submit rate is too high");
+    io_uring_prep_cancel(sqe, &m_stream.m_info, 0);
+    io_uring_sqe_set_data(sqe, &m_stream.m_cancel_info);
+    ::coro::detail::local_engine().add_io_submit();
+}
+
 tcp_client::tcp_client(const char* addr, int port) noexcept
 {
     m_clientfd = socket(AF_INET, SOCK_STREAM, 0);
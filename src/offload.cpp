@@ -0,0 +1,188 @@
+#include <algorithm>
+
+#include "coro/offload.hpp"
+
+namespace coro::detail
+{
+static inline auto now_ns() noexcept -> uint64_t
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// 析构时先通知所有线程停止再逐个等待，线程执行完队列中剩余的任务后退出
+offload_pool::~offload_pool() noexcept
+{
+    for (auto& thread : m_threads)
+    {
+        thread.request_stop();
+    }
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+/// 首次提交任务时才创建线程，未使用 offload 的程序不产生额外线程
+auto offload_pool::start() noexcept -> void
+{
+    m_threads.reserve(config::kOffloadThreadNum);
+    for (size_t i = 0; i < config::kOffloadThreadNum; i++)
+    {
+        m_threads.emplace_back([this](std::stop_token token) { this->run(token); });
+    }
+}
+
+auto offload_pool::submit(offload_job* job) noexcept -> void
+{
+    std::call_once(m_start_flag, [this]() { this->start(); });
+
+    job->next        = nullptr;
+    job->submit_time = now_ns();
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_tail == nullptr)
+        {
+            m_head = job;
+        }
+        else
+        {
+            m_tail->next = job;
+        }
+        m_tail = job;
+        m_queue_depth++;
+        m_max_queue_depth = std::max(m_max_queue_depth, m_queue_depth);
+    }
+    m_num_submit.fetch_add(1, std::memory_order_relaxed);
+    m_cv.notify_one();
+}
+
+auto offload_pool::get_stats() noexcept -> offload_stats
+{
+    offload_stats stats;
+    stats.num_thread = config::kOffloadThreadNum;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        stats.queue_depth     = m_queue_depth;
+        stats.max_queue_depth = m_max_queue_depth;
+    }
+    stats.num_submit      = m_num_submit.load(std::memory_order_relaxed);
+    stats.num_finish      = m_num_finish.load(std::memory_order_relaxed);
+    stats.total_wait_time = m_total_wait_time.load(std::memory_order_relaxed);
+    stats.max_wait_time   = m_max_wait_time.load(std::memory_order_relaxed);
+    stats.total_run_time  = m_total_run_time.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/// 从队列中摘除 ctx 提交的任务并清理其协程，正在执行的任务清空 ctx，由工作线程在执行结束后清理
+/// 被丢弃的任务不会再执行 await_resume，由这里代为减少 ctx 的等待计数
+auto offload_pool::cancel(context* ctx) noexcept -> size_t
+{
+    std::vector<std::coroutine_handle<>> queued;
+    size_t                               num = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        offload_job*                prev = nullptr;
+        for (auto job = m_head; job != nullptr;)
+        {
+            auto next = job->next;
+            if (job->ctx != ctx)
+            {
+                prev = job;
+                job  = next;
+                continue;
+            }
+            if (prev == nullptr)
+            {
+                m_head = next;
+            }
+            else
+            {
+                prev->next = next;
+            }
+            if (m_tail == job)
+            {
+                m_tail = prev;
+            }
+            m_queue_depth--;
+            queued.push_back(job->handle);
+            job = next;
+        }
+        for (auto job : m_running)
+        {
+            if (job->ctx == ctx)
+            {
+                job->ctx = nullptr;
+                num++;
+            }
+        }
+    }
+
+    num += queued.size();
+    if (num > 0)
+    {
+        ctx->unregister_wait(int(num));
+    }
+    for (auto handle : queued)
+    {
+        clean(handle);
+    }
+    return num;
+}
+
+/// 工作线程主循环：按提交顺序取出任务执行，执行结束后由任务回调将协程提交回原 context
+auto offload_pool::run(std::stop_token token) noexcept -> void
+{
+    while (true)
+    {
+        offload_job* job{nullptr};
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            m_cv.wait(lock, token, [this]() { return m_head != nullptr; });
+            if (m_head == nullptr)
+            {
+                // 收到停止请求且队列为空
+                return;
+            }
+            job    = m_head;
+            m_head = job->next;
+            if (m_head == nullptr)
+            {
+                m_tail = nullptr;
+            }
+            m_queue_depth--;
+            m_running.push_back(job);
+        }
+
+        auto start = now_ns();
+        auto wait  = start - job->submit_time;
+        m_total_wait_time.fetch_add(wait, std::memory_order_relaxed);
+        auto max_wait = m_max_wait_time.load(std::memory_order_relaxed);
+        while (wait > max_wait && !m_max_wait_time.compare_exchange_weak(max_wait, wait, std::memory_order_relaxed)) {}
+
+        job->cb(job);
+        m_total_run_time.fetch_add(now_ns() - start, std::memory_order_relaxed);
+        m_num_finish.fetch_add(1, std::memory_order_relaxed);
+
+        // 持锁检查 ctx 与 cancel 互斥：要么在原 context 被强制停止前提交，要么已被 cancel 丢弃
+        // 提交到 pinned 队列，不会被其他 context 窃取，协程恢复后 job 可能立即析构，之后不能再访问 job
+        std::coroutine_handle<> dropped{nullptr};
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_running.erase(std::find(m_running.begin(), m_running.end(), job));
+            if (job->ctx != nullptr)
+            {
+                job->ctx->get_engine().submit_pinned_task(job->handle, get_priority(job->handle));
+            }
+            else
+            {
+                dropped = job->handle;
+            }
+        }
+        if (dropped)
+        {
+            clean(dropped);
+        }
+    }
+}
+}; // namespace coro::detail
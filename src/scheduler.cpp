@@ -1,46 +1,207 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "coro/scheduler.hpp"
 
 namespace coro
 {
-auto scheduler::init_impl(size_t ctx_cnt) noexcept -> void
+scheduler::scheduler(size_t ctx_cnt, detail::affinity_strategy aff) noexcept
+{
+    s_num_instance.fetch_add(1, std::memory_order_acq_rel);
+    if (ctx_cnt == 0)
+    {
+        ctx_cnt = std::thread::hardware_concurrency();
+    }
+    init_impl(plan_affinity(ctx_cnt, aff), ctx_cnt);
+}
+
+scheduler::scheduler(const std::vector<utils::cpu_list>& cpu_lists) noexcept
+{
+    assert(!cpu_lists.empty() && "scheduler init with empty cpu lists");
+    s_num_instance.fetch_add(1, std::memory_order_acq_rel);
+    init_impl(cpu_lists, cpu_lists.size());
+}
+
+scheduler::~scheduler() noexcept
+{
+    // 已启动但未关闭的实例立即关闭，避免工作线程访问已析构的 scheduler
+    if (m_long_run.load(std::memory_order_acquire))
+    {
+        shutdown_impl(std::chrono::steady_clock::now());
+    }
+    if (this != get_instance())
+    {
+        s_num_instance.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+auto scheduler::current() noexcept -> scheduler&
+{
+    if (linfo.ctx != nullptr && linfo.ctx->get_scheduler() != nullptr)
+    {
+        return *linfo.ctx->get_scheduler();
+    }
+    return *get_instance();
+}
+
+auto scheduler::init_impl(const std::vector<utils::cpu_list>& cpu_lists, size_t num_active) noexcept -> void
 {
     // TODO[lab2b]: Add you codes
-    detail::init_meta_info();
-    m_ctx_cnt = ctx_cnt;
+    // context 与 engine 的 id 全局唯一，仍有独立实例存活时不能重置，否则 id 会重复
+    bool is_default = this == get_instance();
+    if (is_default && s_num_instance.load(std::memory_order_acquire) == 0)
+    {
+        detail::init_meta_info();
+    }
+    m_ctx_cnt = cpu_lists.size();
     m_ctxs    = detail::ctx_container{};
     m_ctxs.reserve(m_ctx_cnt);
     for (int i = 0; i < m_ctx_cnt; i++)
     {
-        m_ctxs.emplace_back(std::make_unique<context>());
+        if (cpu_lists[i].empty())
+        {
+            m_ctxs.emplace_back(std::make_unique<context>());
+            continue;
+        }
+        // 在绑核的临时线程中构造 context，使其内存按首次访问原则分配在对应 numa 节点
+        std::thread(
+            [&]()
+            {
+                utils::set_thread_affinity(cpu_lists[i]);
+                m_ctxs.emplace_back(std::make_unique<context>());
+            })
+            .join();
+        m_ctxs.back()->set_cpu_affinity(cpu_lists[i]);
+    }
+    for (auto& ctx : m_ctxs)
+    {
+        ctx->m_sched = this;
     }
     m_dispatcher.init(m_ctx_cnt, &m_ctxs);
+    m_dispatcher.resize(num_active);
 
 #ifdef ENABLE_MEMORY_ALLOC
-    coro::allocator::memory::mem_alloc_config config;
-    m_mem_alloc.init(config);
-    ginfo.mem_alloc = &m_mem_alloc;
+    if (is_default)
+    {
+        coro::allocator::memory::mem_alloc_config config;
+        m_mem_alloc.init(config);
+        ginfo.mem_alloc = &m_mem_alloc;
+    }
 #endif
-    m_stop_token=m_ctx_cnt;
-    m_ctx_stop_flag=stop_flag_type(m_ctx_cnt, detail::atomic_ref_wrapper<int>{.val = 1});
+    m_long_run.store(false, std::memory_order_relaxed);
+    m_accepting      = true;
+    m_num_rejected   = 0;
+    m_num_active     = num_active;
+    m_min_active     = num_active;
+    m_pending_retire = kNoRetire;
+    m_idle_ticks     = 0;
+    // 只有运行中的 context 计入引用计数，未启动的 context 视为空闲
+    m_stop_token=num_active;
+    m_ctx_stop_flag=stop_flag_type(m_ctx_cnt, detail::atomic_ref_wrapper<int>{.val = 0});
+    for (size_t i = 0; i < num_active; i++)
+    {
+        m_ctx_stop_flag[i].val = 1;
+    }
+}
+
+auto scheduler::plan_affinity(size_t ctx_cnt, detail::affinity_strategy aff) noexcept
+    -> std::vector<utils::cpu_list>
+{
+    std::vector<utils::cpu_list> plan(ctx_cnt);
+    if (aff == detail::affinity_strategy::core)
+    {
+        // context 数量超过可用 cpu 时循环分配
+        auto cpus = utils::get_allowed_cpus();
+        for (size_t i = 0; i < ctx_cnt && !cpus.empty(); i++)
+        {
+            plan[i] = {cpus[i % cpus.size()]};
+        }
+    }
+    else if (aff == detail::affinity_strategy::numa_node)
+    {
+        // 连续编号的 context 分到同一 numa 节点，各节点的 context 数量尽量相等
+        auto nodes = utils::get_numa_cpus();
+        for (size_t i = 0; i < ctx_cnt && !nodes.empty(); i++)
+        {
+            plan[i] = nodes[i * nodes.size() / ctx_cnt];
+        }
+    }
+    return plan;
 }
 
 auto scheduler::start_impl() noexcept -> void{
     for (int i = 0; i < m_ctx_cnt; i++)
     {
-        m_ctxs[i]->set_stop_cb(
-            [&, i]()
-            {
-                // context 将其关联的状态设置为 0 即已执行完所有任务，cnt 总是为 1
-                auto cnt = std::atomic_ref(this->m_ctx_stop_flag[i].val).fetch_and(0, memory_order_acq_rel);
-                // 将 scheduler 的引用计数减 1，如果引用计数降至 0，那么触发 scheduler 发送停止信号
-                //当全局忙碌计数减到 0 时，说明当前这个 context 是最后一个忙碌的，该触发停止了
-                if (this->m_stop_token.fetch_sub(cnt) == cnt)
+        // 退役 context 排队中的任务重新经 dispatcher 分发给仍在运行的 context
+        m_ctxs[i]->set_migrate_cb([this](std::coroutine_handle<> handle, task_priority prio)
+                                  { this->submit_task_impl(handle, prio); });
+        if (m_long_run.load(std::memory_order_acquire))
+        {
+            // 长期运行模式下 context 空闲时不通知 scheduler，只阻塞在 eventfd 上等待新任务
+            m_ctxs[i]->set_stop_cb([]() {});
+        }
+        else
+        {
+            m_ctxs[i]->set_stop_cb(
+                [&, i]()
                 {
-                    this->stop_impl();
-                }
-            });
-        m_ctxs[i]->start();
+                    // context 将其关联的状态设置为 0 即已执行完所有任务，cnt 总是为 1
+                    auto cnt = std::atomic_ref(this->m_ctx_stop_flag[i].val).fetch_and(0, memory_order_acq_rel);
+                    // 将 scheduler 的引用计数减 1，如果引用计数降至 0，那么触发 scheduler 发送停止信号
+                    //当全局忙碌计数减到 0 时，说明当前这个 context 是最后一个忙碌的，该触发停止了
+                    if (this->m_stop_token.fetch_sub(cnt) == cnt)
+                    {
+                        this->stop_impl();
+                    }
+                });
+        }
+        if constexpr (config::kDispatchStrategy == detail::dispatch_strategy::work_stealing)
+        {
+            m_ctxs[i]->set_steal_cb([&, i]() { return this->steal_impl(i); });
+        }
+        if (i < m_num_active.load(std::memory_order_acquire))
+        {
+            m_ctxs[i]->start();
+        }
+    }
+}
+
+auto scheduler::steal_impl(size_t thief) noexcept -> bool
+{
+    // 选择共享任务队列最长的 context 作为窃取对象，本地缓冲区中的任务只能由其所属线程执行
+    // 只从仍在运行的 context 窃取，退役中的 context 会自行迁出任务
+    auto num_active = m_num_active.load(std::memory_order_acquire);
+    if (thief >= num_active)
+    {
+        return false;
+    }
+    size_t victim  = thief;
+    size_t max_num = 0;
+    for (size_t i = 1; i < num_active; i++)
+    {
+        auto id  = (thief + i) % num_active;
+        auto num = m_ctxs[id]->get_engine().num_task_stealable();
+        if (num > max_num)
+        {
+            max_num = num;
+            victim  = id;
+        }
     }
+    if (victim == thief)
+    {
+        return false;
+    }
+
+    // 窃取前先将 thief 标记为忙碌，否则 victim 空闲后 scheduler 可能在被窃取的任务执行前停止，
+    // 如果没有窃取到任务，context 随后的空闲检查会通过 stop_cb 重新将其标记为空闲
+    if (!m_long_run.load(std::memory_order_acquire))
+    {
+        m_stop_token.fetch_add(
+            1 - std::atomic_ref(m_ctx_stop_flag[thief].val).fetch_or(1, memory_order_acq_rel), memory_order_acq_rel);
+    }
+    return m_ctxs[thief]->get_engine().steal_from(m_ctxs[victim]->get_engine(), config::kStealBatchSize) > 0;
 }
 
 auto scheduler::loop_impl() noexcept -> void
@@ -52,6 +213,164 @@ auto scheduler::loop_impl() noexcept -> void
     }
 }
 
+auto scheduler::start_long_run_impl() noexcept -> void
+{
+    m_long_run.store(true, std::memory_order_release);
+    start_impl();
+    if (m_min_active < m_ctx_cnt)
+    {
+        m_scaler = std::jthread([this](std::stop_token token) { this->scale_loop(token); });
+    }
+}
+
+auto scheduler::scale_loop(std::stop_token token) noexcept -> void
+{
+    std::mutex                   mtx;
+    std::condition_variable_any  cv;
+    std::unique_lock<std::mutex> lock(mtx);
+
+    m_last_tick      = engine::steady_now_ns();
+    m_last_idle_time = 0;
+    for (auto& ctx : m_ctxs)
+    {
+        m_last_idle_time += ctx->get_engine().idle_time();
+    }
+    while (!token.stop_requested())
+    {
+        // 收到停止请求时立即返回
+        cv.wait_for(lock, token, std::chrono::milliseconds(config::kScaleInterval), []() { return false; });
+        if (!token.stop_requested())
+        {
+            scale_tick();
+        }
+    }
+}
+
+auto scheduler::scale_tick() noexcept -> void
+{
+    auto active = m_num_active.load(std::memory_order_acquire);
+
+    // 统计运行中 context 的负载以及所有 context 在本周期内的阻塞时长
+    size_t load = 0;
+    for (size_t i = 0; i < active; i++)
+    {
+        load += m_ctxs[i]->get_engine().num_task_load();
+    }
+    uint64_t idle_time = 0;
+    for (auto& ctx : m_ctxs)
+    {
+        idle_time += ctx->get_engine().idle_time();
+    }
+    auto now      = engine::steady_now_ns();
+    auto elapsed  = std::max<uint64_t>(now - m_last_tick, 1);
+    auto idle_pct = idle_time > m_last_idle_time ? (idle_time - m_last_idle_time) * 100 / (elapsed * active) : 0;
+    m_last_tick      = now;
+    m_last_idle_time = idle_time;
+
+    if (load > active * config::kScaleUpLoad && active < m_ctx_cnt)
+    {
+        m_idle_ticks = 0;
+        if (m_pending_retire == active)
+        {
+            // 待退役的 context 尚未停止，直接恢复分发即可
+            m_pending_retire = kNoRetire;
+        }
+        else if (m_ctxs[active]->is_finished())
+        {
+            // 回收已退役线程后重新启动，context 仍使用原先的绑核设置与回调
+            m_ctxs[active]->join();
+            m_ctxs[active]->start();
+        }
+        else
+        {
+            // 该 context 仍在完成退役前遗留的 IO，下个周期再扩容
+            return;
+        }
+        m_dispatcher.resize(active + 1);
+        m_num_active.store(active + 1, std::memory_order_release);
+        return;
+    }
+
+    // 上个周期已从 dispatcher 移除的 context 在本周期退役，仍选中它的提交会被拒绝并重新分发
+    if (m_pending_retire != kNoRetire)
+    {
+        m_ctxs[m_pending_retire]->retire();
+        m_pending_retire = kNoRetire;
+    }
+
+    if (idle_pct < config::kScaleDownIdlePercent)
+    {
+        m_idle_ticks = 0;
+        return;
+    }
+    if (++m_idle_ticks >= config::kScaleDownTicks && active > m_min_active)
+    {
+        // 先停止向编号最大的 context 分发任务，下个周期再令其退役
+        m_num_active.store(active - 1, std::memory_order_release);
+        m_dispatcher.resize(active - 1);
+        m_pending_retire = active - 1;
+    }
+}
+
+auto scheduler::shutdown_impl(std::chrono::steady_clock::time_point deadline) noexcept -> shutdown_report
+{
+    assert(m_long_run.load(std::memory_order_acquire) && "shutdown must be called after scheduler start");
+    shutdown_report report;
+
+    // 先停止扩缩容，之后运行中的 context 集合不再变化
+    if (m_scaler.joinable())
+    {
+        m_scaler.request_stop();
+        m_scaler.join();
+    }
+
+    // 先停止接收外部任务，再通知各 context 排空任务与 IO 后退出
+    m_accepting.store(false, std::memory_order_release);
+    stop_impl();
+
+    auto all_finished = [this]()
+    { return std::all_of(m_ctxs.begin(), m_ctxs.end(), [](auto& ctx) { return ctx->is_finished(); }); };
+    while (!all_finished() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // 超时后强制停止仍在运行的 context，正在执行的任务挂起或结束后 context 立即退出
+    if (!all_finished())
+    {
+        report.drained = false;
+        for (auto& ctx : m_ctxs)
+        {
+            ctx->force_stop();
+        }
+    }
+    for (auto& ctx : m_ctxs)
+    {
+        ctx->join();
+        report.num_cancelled_task += ctx->num_cancelled_task();
+        report.num_cancelled_io += ctx->num_cancelled_io();
+    }
+    report.num_rejected_task = m_num_rejected.load(std::memory_order_acquire);
+    m_long_run.store(false, std::memory_order_release);
+    return report;
+}
+
+auto scheduler::reject_impl(std::span<const std::coroutine_handle<>> handles, task_priority prio) noexcept -> void
+{
+    // context 在排空结束前不会退出，其内部任务提交的新任务交给所在 context 继续执行，
+    // 只有本实例的 context 参与本实例的排空，其他实例的 context 提交的任务同样拒绝
+    if (detail::is_in_working_state() && local_context().get_scheduler() == this)
+    {
+        local_context().submit_batch(handles, prio);
+        return;
+    }
+    for (auto handle : handles)
+    {
+        clean(handle);
+    }
+    m_num_rejected.fetch_add(handles.size(), std::memory_order_acq_rel);
+}
+
 auto scheduler::stop_impl() noexcept -> void
 {
     // TODO[lab2b]: example function
@@ -63,15 +382,125 @@ auto scheduler::stop_impl() noexcept -> void
     }
 }
 
-auto scheduler::submit_task_impl(std::coroutine_handle<> handle) noexcept -> void
+auto scheduler::snapshot_stats_impl() noexcept -> scheduler_stats
+{
+    scheduler_stats stats;
+    stats.ctxs.reserve(m_ctxs.size());
+    auto& total = stats.total;
+    for (auto& ctx : m_ctxs)
+    {
+        auto& cs = stats.ctxs.emplace_back(ctx->get_stats());
+        total.num_task_exec += cs.num_task_exec;
+        total.num_cqe += cs.num_cqe;
+        total.num_wakeup += cs.num_wakeup;
+        total.idle_time += cs.idle_time;
+        total.num_io_running += cs.num_io_running;
+        total.num_io_wait_submit += cs.num_io_wait_submit;
+        total.num_task_queued += cs.num_task_queued;
+        total.num_wait_task += cs.num_wait_task;
+        total.num_steal += cs.num_steal;
+        total.max_task_queued = std::max(total.max_task_queued, cs.max_task_queued);
+    }
+    return stats;
+}
+
+auto scheduler::submit_task_impl(std::coroutine_handle<> handle, task_priority prio) noexcept -> void
 {
     // TODO[lab2b]: Add you codes
+    submit_to_ctx_impl(m_dispatcher.dispatch(), handle, prio);
+}
+
+auto scheduler::submit_by_key_impl(std::coroutine_handle<> handle, uint64_t key, task_priority prio) noexcept -> void
+{
+    // 只有 affinity_hash 等支持 key 的分发策略才使用 key，其他策略忽略 key
+    submit_to_ctx_impl(detail::dispatch_by_key(m_dispatcher, key), handle, prio);
+}
+
+auto scheduler::submit_to_id_impl(std::coroutine_handle<> handle, ctx_id id, task_priority prio) noexcept -> void
+{
+    // init 时 context 在同一循环中依次创建，id 通常连续，先按偏移定位，不匹配时再线性查找
+    auto   num_active = m_num_active.load(std::memory_order_acquire);
+    size_t index      = id - m_ctxs[0]->get_ctx_id();
+    if (index >= num_active || m_ctxs[index]->get_ctx_id() != id)
+    {
+        index = 0;
+        while (index < num_active && m_ctxs[index]->get_ctx_id() != id)
+        {
+            index++;
+        }
+    }
+    if (index >= num_active) [[unlikely]]
+    {
+        // 目标 context 不存在或已被回收，交给 dispatcher 选择
+        submit_task_impl(handle, prio);
+        return;
+    }
+    submit_to_ctx_impl(index, handle, prio);
+}
+
+auto scheduler::submit_batch_impl(std::span<const std::coroutine_handle<>> handles, task_priority prio) noexcept
+    -> void
+{
+    if (handles.empty())
+    {
+        return;
+    }
+    if (!m_accepting.load(std::memory_order_acquire)) [[unlikely]]
+    {
+        reject_impl(handles, prio);
+        return;
+    }
+
+    // 只调用一次 dispatcher 决定起始 context，任务均分为连续的若干段，
+    // 每个 context 只需一次 stop-token 更新、一次批量入队以及至多一次唤醒
+    auto start      = m_dispatcher.dispatch();
+    auto num_active = m_num_active.load(std::memory_order_acquire);
+    auto num_ctx    = std::min(handles.size(), num_active);
+    auto chunk   = handles.size() / num_ctx;
+    auto remain  = handles.size() % num_ctx;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < num_ctx; i++)
+    {
+        auto len    = chunk + (i < remain ? 1 : 0);
+        auto ctx_id = (start + i) % num_active;
+        mark_ctx_busy(ctx_id);
+        if (!m_ctxs[ctx_id]->try_submit_batch(handles.subspan(offset, len), prio)) [[unlikely]]
+        {
+            // 目标 context 已开始退役，这一段重新分发给仍在运行的 context
+            submit_batch_impl(handles.subspan(offset, len), prio);
+        }
+        offset += len;
+    }
+}
+
+auto scheduler::submit_to_ctx_impl(size_t ctx_id, std::coroutine_handle<> handle, task_priority prio) noexcept -> void
+{
+    if (!m_accepting.load(std::memory_order_acquire)) [[unlikely]]
+    {
+        reject_impl(std::span<const std::coroutine_handle<>>(&handle, 1), prio);
+        return;
+    }
+    mark_ctx_busy(ctx_id);
+    while (!m_ctxs[ctx_id]->try_submit_task(handle, prio)) [[unlikely]]
+    {
+        // 目标 context 在选中后开始退役，它已从 dispatcher 移除，重新分发即可选到运行中的 context
+        ctx_id = m_dispatcher.dispatch();
+        mark_ctx_busy(ctx_id);
+    }
+}
+
+auto scheduler::mark_ctx_busy(size_t ctx_id) noexcept -> void
+{
+    // 长期运行模式下 context 不会自行停止，无需维护引用计数
+    if (m_long_run.load(std::memory_order_acquire))
+    {
+        return;
+    }
     assert(this->m_stop_token.load(std::memory_order_acquire) != 0 && "error! submit task after scheduler loop finish");
-    size_t ctx_id = m_dispatcher.dispatch();
     //m_stop_token = 活跃 context 数量
     //当 m_stop_token 降为 0 时 → 所有 context 都空闲 → 触发 stop_impl()
     m_stop_token.fetch_add(
         1 - std::atomic_ref(m_ctx_stop_flag[ctx_id].val).fetch_or(1, memory_order_acq_rel), memory_order_acq_rel);
-    m_ctxs[ctx_id]->submit_task(handle);
 }
 }; // namespace coro
@@ -1,5 +1,10 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <fcntl.h>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
 
 #include "coro/utils.hpp"
 
@@ -20,6 +25,103 @@ auto get_null_fd() noexcept -> int
     return fd;
 }
 
+auto get_allowed_cpus() noexcept -> cpu_list
+{
+    cpu_list  cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    {
+        return cpus;
+    }
+    for (int i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (CPU_ISSET(i, &set))
+        {
+            cpus.push_back(i);
+        }
+    }
+    return cpus;
+}
+
+auto get_numa_cpus() noexcept -> std::vector<cpu_list>
+{
+    auto allowed = get_allowed_cpus();
+
+    std::vector<cpu_list> nodes;
+    for (int node = 0;; node++)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file.is_open())
+        {
+            break;
+        }
+        std::string line;
+        std::getline(file, line);
+
+        cpu_list cpus;
+        for (auto cpu : parse_cpu_list(line))
+        {
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty())
+        {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+
+    if (nodes.empty() && !allowed.empty())
+    {
+        nodes.push_back(std::move(allowed));
+    }
+    return nodes;
+}
+
+auto parse_cpu_list(const std::string& s) noexcept -> cpu_list
+{
+    cpu_list cpus;
+    size_t   pos = 0;
+    while (pos < s.size())
+    {
+        auto end = s.find(',', pos);
+        end      = end == std::string::npos ? s.size() : end;
+
+        int  first = 0, last = 0;
+        auto item  = s.substr(pos, end - pos);
+        auto num   = sscanf(item.c_str(), "%d-%d", &first, &last);
+        if (num == 1)
+        {
+            cpus.push_back(first);
+        }
+        else if (num == 2)
+        {
+            for (int i = first; i <= last; i++)
+            {
+                cpus.push_back(i);
+            }
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+auto set_thread_affinity(const cpu_list& cpus) noexcept -> bool
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
 auto trim(std::string& s, const char* to_trim) noexcept -> std::string&
 {
     if (s.empty())
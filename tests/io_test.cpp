@@ -0,0 +1,495 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "coro/io/io_awaiter.hpp"
+#include "coro/io/net/tcp/tcp.hpp"
+#include "coro/scheduler.hpp"
+#include "gtest/gtest.h"
+
+using namespace coro;
+
+/*************************************************************
+ *                       pre-definition                      *
+ *************************************************************/
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+class IoTest : public ::testing::Test
+{
+protected:
+    void SetUp() override {}
+
+    void TearDown() override {}
+
+    std::vector<int> m_vec;
+    std::mutex       m_mtx;
+};
+
+task<> accept_stream_func(std::vector<int>& vec, std::atomic<int>& port, int conn_num)
+{
+    auto server = io::net::tcp::tcp_server(0);
+    port.store(server.port(), std::memory_order_release);
+    auto stream = server.accept_stream();
+    for (int i = 0; i < conn_num; i++)
+    {
+        vec.push_back(co_await stream.next());
+    }
+    co_await stream.cancel();
+
+    // wait client closing first, so the server side isn't left in TIME_WAIT
+    char buf[1];
+    for (auto fd : vec)
+    {
+        if (fd >= 0)
+        {
+            auto conn = io::net::tcp::tcp_connector(fd);
+            co_await conn.read(buf, sizeof(buf));
+            co_await conn.close();
+        }
+    }
+}
+
+auto connect_loopback(std::atomic<int>& port) -> int
+{
+    // wait server binding the ephemeral port
+    while (port.load(std::memory_order_acquire) == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port.load(std::memory_order_relaxed));
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    // server may not listen yet, retry for a while
+    for (int i = 0; i < 1000; i++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0)
+        {
+            return fd;
+        }
+        ::close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return -1;
+}
+
+task<> recv_stream_func(std::vector<int>& vec, int fd)
+{
+    auto conn   = io::net::tcp::tcp_connector(fd);
+    auto stream = conn.recv_stream();
+    while (true)
+    {
+        auto buf = co_await stream.next();
+        if (buf.result() == -ENOBUFS)
+        {
+            continue;
+        }
+        if (buf.result() <= 0)
+        {
+            break;
+        }
+        for (int i = 0; i < buf.result(); i++)
+        {
+            vec.push_back(buf.data()[i]);
+        }
+    }
+    co_await stream.cancel();
+    co_await conn.close();
+}
+
+task<> fixed_buffer_pipe_func(std::vector<int>& vec, int val, std::mutex& mtx)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        co_return;
+    }
+
+    auto out = io::fixed_buffer();
+    auto in  = io::fixed_buffer();
+    if (out.valid() && in.valid() && out.index() != in.index())
+    {
+        memcpy(out.data(), &val, sizeof(val));
+        auto ret = co_await io::write_fixed_awaiter(fds[1], out.data(), sizeof(val), out.index());
+        if (ret == sizeof(val))
+        {
+            ret = co_await io::read_fixed_awaiter(fds[0], in.data(), sizeof(val), in.index());
+        }
+        if (ret == sizeof(val))
+        {
+            int res;
+            memcpy(&res, in.data(), sizeof(res));
+            std::lock_guard<std::mutex> lock(mtx);
+            vec.push_back(res);
+        }
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+task<> fixed_buffer_lease_func(std::vector<int>& vec)
+{
+    std::vector<io::fixed_buffer> bufs;
+    for (size_t i = 0; i < config::kFixedBufNum; i++)
+    {
+        bufs.emplace_back();
+        vec.push_back(bufs.back().index());
+    }
+    // pool is used up
+    vec.push_back(io::fixed_buffer().index());
+
+    // returned buffer can be leased again
+    bufs.pop_back();
+    vec.push_back(io::fixed_buffer().valid());
+    co_return;
+}
+
+task<> send_zc_func(std::vector<int>& vec, std::atomic<int>& port, int data_len)
+{
+    auto server = io::net::tcp::tcp_server(0);
+    port.store(server.port(), std::memory_order_release);
+    auto fd     = co_await server.accept();
+    if (fd < 0)
+    {
+        co_return;
+    }
+
+    auto              conn = io::net::tcp::tcp_connector(fd);
+    std::vector<char> data(data_len);
+    for (int i = 0; i < data_len; i++)
+    {
+        data[i] = char(i % 128);
+    }
+
+    // large chunks go zero-copy, the tail is below threshold and falls back to normal send
+    int off = 0;
+    while (off < data_len - 100)
+    {
+        auto ret = co_await conn.write_zc(data.data() + off, data_len - 100 - off);
+        if (ret <= 0)
+        {
+            co_return;
+        }
+        off += ret;
+    }
+    iovec  iov{.iov_base = data.data() + off, .iov_len = size_t(data_len - off)};
+    msghdr msg{};
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+    vec.push_back(co_await conn.sendmsg_zc(&msg));
+
+    // wait client closing first, so the server side isn't left in TIME_WAIT
+    char buf[1];
+    co_await conn.read(buf, sizeof(buf));
+    co_await conn.close();
+}
+
+task<> send_zc_timeout_func(std::vector<int>& vec, std::atomic<int>& port)
+{
+    using namespace std::chrono_literals;
+
+    auto server = io::net::tcp::tcp_server(0);
+    port.store(server.port(), std::memory_order_release);
+    auto fd = co_await server.accept();
+    if (fd < 0)
+    {
+        co_return;
+    }
+
+    // client never reads, so a send blocks once the socket buffers are full and times out
+    auto              conn = io::net::tcp::tcp_connector(fd);
+    std::vector<char> data(1 << 20);
+    int               ret = 0;
+    for (int i = 0; i < 1024 && ret >= 0; i++)
+    {
+        ret = co_await conn.write_zc(data.data(), data.size()).timeout(20ms);
+    }
+    vec.push_back(ret);
+    co_await conn.close();
+}
+
+task<> link_timeout_func(std::vector<int>& vec)
+{
+    using namespace std::chrono_literals;
+
+    // no client connects
+    auto server = io::net::tcp::tcp_server(0);
+    vec.push_back(co_await server.accept().timeout(20ms));
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        co_return;
+    }
+    auto conn = io::net::tcp::tcp_connector(fds[0]);
+    char buf[16];
+
+    // no data arrives
+    vec.push_back(co_await conn.read(buf, sizeof(buf)).timeout(20ms));
+
+    // data arrives in time
+    ::write(fds[1], "hello", 5);
+    vec.push_back(co_await conn.read(buf, sizeof(buf)).timeout(1s));
+
+    // another sqe is prepared between the read and its timeout, the read fails without running
+    auto read = conn.read(buf, sizeof(buf));
+    auto nop  = io::noop_awaiter{};
+    vec.push_back(co_await read.timeout(1s));
+    vec.push_back(co_await nop.timeout(1s));
+
+    ::close(fds[1]);
+    co_await conn.close();
+}
+
+task<> uring_op_pipe_func(std::vector<int>& vec, int val, std::mutex& mtx)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        co_return;
+    }
+
+    int  out = val;
+    int  in  = -1;
+    auto ret = co_await io::uring_op([&](io_uring_sqe* sqe) { io_uring_prep_write(sqe, fds[1], &out, sizeof(out), 0); });
+    if (ret == sizeof(out))
+    {
+        ret = co_await io::uring_op([&](io_uring_sqe* sqe) { io_uring_prep_read(sqe, fds[0], &in, sizeof(in), 0); });
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    mtx.lock();
+    vec.push_back(ret == sizeof(in) ? in : -1);
+    mtx.unlock();
+}
+
+/*************************************************************
+ *                          tests                            *
+ *************************************************************/
+
+TEST_F(IoTest, PipeReadWrite)
+{
+    const int task_num = 100;
+    scheduler::init();
+
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(uring_op_pipe_func(m_vec, i, m_mtx));
+    }
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+TEST_F(IoTest, AcceptAndCancel)
+{
+    const int        conn_num = 64;
+    std::atomic<int> port{0};
+    scheduler::init(1);
+
+    submit_to_scheduler(accept_stream_func(m_vec, port, conn_num));
+
+    std::thread client(
+        [&]()
+        {
+            std::vector<int> fds;
+            for (int i = 0; i < conn_num; i++)
+            {
+                fds.push_back(connect_loopback(port));
+            }
+            for (auto fd : fds)
+            {
+                ::close(fd);
+            }
+        });
+
+    scheduler::loop();
+    client.join();
+
+    ASSERT_EQ(m_vec.size(), conn_num);
+    for (auto fd : m_vec)
+    {
+        ASSERT_GT(fd, 0);
+    }
+}
+
+TEST_F(IoTest, RecvUntilPeerClose)
+{
+    const int data_len = 100000;
+    int       fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    scheduler::init(1);
+
+    submit_to_scheduler(recv_stream_func(m_vec, fds[0]));
+
+    std::thread writer(
+        [&]()
+        {
+            std::vector<char> data(data_len);
+            for (int i = 0; i < data_len; i++)
+            {
+                data[i] = char(i % 128);
+            }
+            for (int off = 0; off < data_len;)
+            {
+                auto ret = ::write(fds[1], data.data() + off, std::min(data_len - off, 1000));
+                if (ret <= 0)
+                {
+                    break;
+                }
+                off += ret;
+            }
+            ::close(fds[1]);
+        });
+
+    scheduler::loop();
+    writer.join();
+
+    ASSERT_EQ(m_vec.size(), data_len);
+    for (int i = 0; i < data_len; i++)
+    {
+        ASSERT_EQ(m_vec[i], i % 128);
+    }
+}
+
+TEST_F(IoTest, PipeReadWriteFixed)
+{
+    const int task_num = 16;
+    scheduler::init(1);
+
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(fixed_buffer_pipe_func(m_vec, i, m_mtx));
+    }
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+TEST_F(IoTest, LeaseUntilEmpty)
+{
+    scheduler::init(1);
+
+    submit_to_scheduler(fixed_buffer_lease_func(m_vec));
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), config::kFixedBufNum + 2);
+    std::sort(m_vec.begin(), m_vec.begin() + config::kFixedBufNum);
+    for (int i = 0; i < config::kFixedBufNum; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+    ASSERT_EQ(m_vec[config::kFixedBufNum], -1);
+    ASSERT_EQ(m_vec[config::kFixedBufNum + 1], 1);
+}
+
+TEST_F(IoTest, LargeAndSmallWrites)
+{
+    const int        data_len = 1 << 20;
+    std::atomic<int> port{0};
+    scheduler::init(1);
+
+    submit_to_scheduler(send_zc_func(m_vec, port, data_len));
+
+    std::vector<char> recv_data;
+    std::thread       client(
+        [&]()
+        {
+            int  fd = connect_loopback(port);
+            char buf[65536];
+            while (recv_data.size() < data_len)
+            {
+                auto ret = ::read(fd, buf, sizeof(buf));
+                if (ret <= 0)
+                {
+                    break;
+                }
+                recv_data.insert(recv_data.end(), buf, buf + ret);
+            }
+            ::close(fd);
+        });
+
+    scheduler::loop();
+    client.join();
+
+    ASSERT_EQ(m_vec.size(), 1);
+    ASSERT_EQ(m_vec[0], 100);
+    ASSERT_EQ(recv_data.size(), data_len);
+    for (int i = 0; i < data_len; i++)
+    {
+        ASSERT_EQ(recv_data[i], char(i % 128));
+    }
+}
+
+TEST_F(IoTest, TimeoutOrFinishInTime)
+{
+    scheduler::init(1);
+
+    submit_to_scheduler(link_timeout_func(m_vec));
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), 5);
+    ASSERT_EQ(m_vec[0], -ETIME);
+    ASSERT_EQ(m_vec[1], -ETIME);
+    ASSERT_EQ(m_vec[2], 5);
+    ASSERT_EQ(m_vec[3], -EINVAL);
+    ASSERT_EQ(m_vec[4], 0);
+}
+
+TEST_F(IoTest, SendZcTimeout)
+{
+    std::atomic<int>  port{0};
+    std::atomic<bool> done{false};
+    scheduler::init(1);
+
+    submit_to_scheduler(send_zc_timeout_func(m_vec, port));
+
+    std::thread client(
+        [&]()
+        {
+            int fd = connect_loopback(port);
+            while (!done)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            ::close(fd);
+        });
+
+    scheduler::loop();
+    done = true;
+    client.join();
+
+    ASSERT_EQ(m_vec.size(), 1);
+    ASSERT_EQ(m_vec[0], -ETIME);
+}
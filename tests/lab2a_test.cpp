@@ -7,6 +7,7 @@
 #include "coro/io/io_info.hpp"
 #include "coro/task.hpp"
 #include "coro/utils.hpp"
+#include "coro/yield.hpp"
 #include "gtest/gtest.h"
 
 using namespace coro;
@@ -70,6 +71,25 @@ task<> func(std::vector<int>& vec, int val)
     co_return;
 }
 
+task<> yield_func(std::vector<int>& vec, int start, int num)
+{
+    for (int i = 0; i < num; i++)
+    {
+        vec.push_back(start + 2 * i);
+        co_await coro::yield();
+    }
+}
+
+task<> yield_budget_func(std::vector<int>& vec, int num, size_t budget_ops)
+{
+    yield_budget budget(budget_ops);
+    for (int i = 0; i < num; i++)
+    {
+        vec.push_back(i);
+        co_await budget.consume();
+    }
+}
+
 void io_cb(io_info* info, int res)
 {
     auto num = reinterpret_cast<int*>(info->data);
@@ -240,6 +260,45 @@ TEST_F(EngineTest, ExecOneNoDetachTaskByEngine)
     ASSERT_EQ(m_vec[0], 1);
 }
 
+// test one engine steal tasks from another engine, thief should steal
+// half of victim's tasks and all tasks should be executed exactly once
+TEST_F(EngineTest, StealTaskFromOtherEngine)
+{
+    detail::engine thief;
+    thief.init();
+    ASSERT_EQ(thief.steal_from(m_engine, config::kStealBatchSize), 0);
+
+    const int task_num = 100;
+    for (int i = 0; i < task_num; i++)
+    {
+        auto task = func(m_vec, i);
+        m_engine.submit_task(task.handle());
+        task.detach();
+    }
+
+    auto stolen = thief.steal_from(m_engine, config::kStealBatchSize);
+    ASSERT_EQ(stolen, std::min<size_t>(task_num / 2, config::kStealBatchSize));
+    ASSERT_EQ(thief.num_task_schedule(), stolen);
+    ASSERT_EQ(m_engine.num_task_schedule(), task_num - stolen);
+
+    while (thief.ready())
+    {
+        thief.exec_one_task();
+    }
+    while (m_engine.ready())
+    {
+        m_engine.exec_one_task();
+    }
+    thief.deinit();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
 // TODO: Add more nopio tests for engine
 // // test add nop-io before engine poll
 // TEST_F(EngineTest, AddNopIOBeforePoll)
@@ -365,6 +424,230 @@ TEST_F(EngineTest, LoopAddNopIO)
     }
 }
 
+// test cqe budget, one poll handles at most kMaxCqePerTurn cqes and the rest are handled
+// by later polls without blocking
+TEST_F(EngineTest, CqeBudgetPerPoll)
+{
+    if constexpr (config::kMaxCqePerTurn == 0 || config::kPollStrategy == detail::poll_strategy::submit_and_wait)
+    {
+        GTEST_SKIP() << "cqe budget is disabled or cqes may be reaped when submitting";
+    }
+
+    const int            io_num = 2 * config::kMaxCqePerTurn + 1;
+    std::vector<io_info> infos(io_num);
+    m_vec = std::vector<int>(io_num, 1);
+    for (int i = 0; i < io_num; i++)
+    {
+        infos[i].data = reinterpret_cast<uintptr_t>(&m_vec[i]);
+        infos[i].cb   = io_cb;
+        auto sqe      = m_engine.get_free_urs();
+        ASSERT_NE(sqe, nullptr);
+        io_uring_prep_nop(sqe);
+        io_uring_sqe_set_data(sqe, &infos[i]);
+        m_engine.add_io_submit();
+    }
+
+    // nop completes when it is submitted, so all cqes are in cq before the first reap
+    m_engine.poll_submit();
+    ASSERT_EQ(std::count(m_vec.begin(), m_vec.end(), 0), config::kMaxCqePerTurn);
+
+    int num_poll = 1;
+    while (!m_engine.empty_io())
+    {
+        m_engine.poll_submit();
+        num_poll++;
+    }
+    ASSERT_EQ(num_poll, 3);
+    ASSERT_EQ(std::count(m_vec.begin(), m_vec.end(), 0), io_num);
+}
+
+// test busy poll counters, engine only spins when busy poll is enabled
+TEST_F(EngineTest, BusyPollCounter)
+{
+    m_vec.push_back(1);
+    io_info info;
+    info.data = reinterpret_cast<uintptr_t>(&m_vec[0]);
+    info.cb   = io_cb;
+
+    auto sqe = m_engine.get_free_urs();
+    ASSERT_NE(sqe, nullptr);
+    io_uring_prep_nop(sqe);
+    io_uring_sqe_set_data(sqe, &info);
+    m_engine.add_io_submit();
+
+    do
+    {
+        m_engine.poll_submit();
+    } while (!m_engine.empty_io());
+    ASSERT_EQ(m_vec[0], 0);
+    ASSERT_EQ(m_engine.num_spin_hit() + m_engine.num_spin_sleep() > 0, config::kBusyPollMaxTime > 0);
+}
+
+// test tasks submitted by the thread which owns engine won't make poll_submit block
+TEST_F(EngineTest, PollNotBlockWithLocalTask)
+{
+    const int task_num = 10;
+    for (int i = 0; i < task_num; i++)
+    {
+        auto task = func(m_vec, i);
+        m_engine.submit_task(task.handle());
+        task.detach();
+    }
+
+    m_engine.poll_submit();
+    ASSERT_TRUE(m_engine.ready());
+    ASSERT_EQ(m_engine.num_task_schedule(), task_num);
+    ASSERT_EQ(m_engine.num_task_stealable(), 0);
+    while (m_engine.ready())
+    {
+        m_engine.exec_one_task();
+    }
+    ASSERT_EQ(m_engine.num_task_schedule(), 0);
+    ASSERT_EQ(m_vec.size(), task_num);
+
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+// test tasks beyond task queue capacity spill to overflow queue and are all executed
+TEST_F(EngineTest, ExecTaskBeyondQueueCapacity)
+{
+    const int task_num = 2 * config::kQueCap;
+    auto      t1       = std::thread(
+        [&]()
+        {
+            for (int i = 0; i < task_num; i++)
+            {
+                auto task = func(m_vec, i);
+                m_engine.submit_task(task.handle());
+                task.detach();
+            }
+        });
+    t1.join();
+
+    ASSERT_EQ(m_engine.num_task_schedule(), task_num);
+    ASSERT_GE(m_engine.num_overflow_push(), task_num - config::kQueCap);
+    ASSERT_EQ(m_engine.max_task_overflow(), m_engine.num_task_overflow());
+    while (m_engine.ready())
+    {
+        m_engine.exec_one_task();
+    }
+    ASSERT_EQ(m_engine.num_task_overflow(), 0);
+    ASSERT_EQ(m_vec.size(), task_num);
+
+    // overflow queue keeps fifo order of shared tasks
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+// test tasks of higher priority class run ahead of lower classes
+TEST_F(EngineTest, ExecTaskByPriority)
+{
+    const int task_num = 10;
+    for (int i = 0; i < task_num; i++)
+    {
+        auto low = func(m_vec, 2 * task_num + i);
+        m_engine.submit_task(low.handle(), detail::task_priority::low);
+        low.detach();
+
+        auto normal = func(m_vec, task_num + i);
+        m_engine.submit_task(normal.handle());
+        normal.detach();
+
+        auto high = func(m_vec, i);
+        m_engine.submit_task(high.handle(), detail::task_priority::high);
+        high.detach();
+    }
+
+    ASSERT_EQ(m_engine.num_task_schedule(), 3 * task_num);
+    while (m_engine.ready())
+    {
+        m_engine.exec_one_task();
+    }
+    ASSERT_EQ(m_engine.num_task_run(detail::task_priority::high), task_num);
+    ASSERT_EQ(m_engine.num_task_run(detail::task_priority::normal), task_num);
+    ASSERT_EQ(m_engine.num_task_run(detail::task_priority::low), task_num);
+
+    // order inside normal class is decided by run-next slot, so only check the order between classes
+    ASSERT_EQ(m_vec.size(), 3 * task_num);
+    for (int i = 0; i < 3; i++)
+    {
+        std::sort(m_vec.begin() + i * task_num, m_vec.begin() + (i + 1) * task_num);
+    }
+    for (int i = 0; i < 3 * task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+// test high priority tasks can't starve normal tasks
+TEST_F(EngineTest, HighPriorityTaskNotStarveOthers)
+{
+    const int task_num = 2 * config::kMaxHighPrioStreak;
+    auto      normal   = func(m_vec, -1);
+    m_engine.submit_task(normal.handle());
+    normal.detach();
+    for (int i = 0; i < task_num; i++)
+    {
+        auto high = func(m_vec, i);
+        m_engine.submit_task(high.handle(), detail::task_priority::high);
+        high.detach();
+    }
+
+    while (m_engine.ready())
+    {
+        m_engine.exec_one_task();
+    }
+    ASSERT_EQ(m_vec.size(), task_num + 1);
+    ASSERT_EQ(m_vec[config::kMaxHighPrioStreak], -1);
+}
+
+// test yielded tasks give engine back to each other, so their outputs interleave
+TEST_F(EngineTest, YieldTaskInterleave)
+{
+    const int task_num = 10;
+    for (int i = 0; i < 2; i++)
+    {
+        auto task = yield_func(m_vec, i, task_num);
+        m_engine.submit_task(task.handle());
+        task.detach();
+    }
+
+    while (m_engine.ready())
+    {
+        m_engine.exec_one_task();
+    }
+    ASSERT_EQ(m_vec.size(), 2 * task_num);
+    for (int i = 1; i < 2 * task_num; i++)
+    {
+        ASSERT_NE(m_vec[i] % 2, m_vec[i - 1] % 2);
+    }
+}
+
+// test task using yield budget only yields after consuming the budget
+TEST_F(EngineTest, YieldBudgetTask)
+{
+    const size_t budget_ops = 4;
+    auto         other      = func(m_vec, -1);
+    m_engine.submit_task(other.handle());
+    other.detach();
+    auto task = yield_budget_func(m_vec, 2 * budget_ops, budget_ops);
+    m_engine.submit_task(task.handle());
+    task.detach();
+
+    while (m_engine.ready())
+    {
+        m_engine.exec_one_task();
+    }
+    ASSERT_EQ(m_vec.size(), 2 * budget_ops + 1);
+    ASSERT_EQ(m_vec[budget_ops], -1);
+}
+
 // test submit task after engine poll
 TEST_F(EngineTest, LastSubmitTaskToEngine)
 {
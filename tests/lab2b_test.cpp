@@ -1,10 +1,19 @@
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <mutex>
+#include <sched.h>
+#include <stdexcept>
 #include <thread>
+#include <unistd.h>
 #include <vector>
 
 #include "coro/io/io_awaiter.hpp"
+#include "coro/offload.hpp"
 #include "coro/scheduler.hpp"
+#include "coro/switch_to.hpp"
+#include "coro/yield.hpp"
 #include "gtest/gtest.h"
 
 using namespace coro;
@@ -70,6 +79,39 @@ class SchedulerAddNopIOTest : public SchedulerRunTaskTest
 {
 };
 
+// features of scheduler that don't need parameterized cases share this fixture
+class SchedulerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override {}
+
+    void TearDown() override {}
+
+    std::vector<int> m_vec;
+    std::mutex       m_mtx;
+};
+
+class DispatcherTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            m_ctxs.emplace_back(std::make_unique<context>());
+        }
+    }
+
+    void TearDown() override {}
+
+    // queue num tasks to context id, tasks are never run and destroyed with m_tasks
+    void add_load(size_t id, int num);
+
+    std::vector<int>      m_vec;
+    std::vector<task<>>   m_tasks;
+    detail::ctx_container m_ctxs;
+};
+
 task<> func(std::vector<int>& vec, int val)
 {
     vec.push_back(val);
@@ -83,6 +125,19 @@ task<> func_nop(std::vector<int>& vec, int val)
     co_return;
 }
 
+task<> nop_child_func()
+{
+    co_await noop_awaiter{};
+}
+
+task<> prio_nop_func(std::vector<int>& vec)
+{
+    co_await noop_awaiter{};
+    co_await nop_child_func();
+    // first run, resume after own io and resume after child's io are all high priority
+    vec.push_back(detail::local_engine().num_task_run(task_priority::high));
+}
+
 task<> mutex_func(std::vector<int>& vec, int val, std::mutex& mtx)
 {
     mtx.lock();
@@ -100,6 +155,14 @@ task<> mutex_func_nop(std::vector<int>& vec, int val, std::mutex& mtx)
     co_return;
 }
 
+task<> cpu_func(std::vector<int>& vec, std::mutex& mtx)
+{
+    mtx.lock();
+    vec.push_back(sched_getcpu());
+    mtx.unlock();
+    co_return;
+}
+
 task<> submit_scheduler_func(std::vector<int>& vec, int id)
 {
     if (id == 0)
@@ -111,6 +174,124 @@ task<> submit_scheduler_func(std::vector<int>& vec, int id)
     co_return;
 }
 
+task<> sleep_func(std::vector<int>& vec, int val, std::mutex& mtx)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+    mtx.lock();
+    vec.push_back(val);
+    mtx.unlock();
+    co_return;
+}
+
+task<> offload_func(std::vector<int>& vec, int val, std::mutex& mtx)
+{
+    auto origin = &local_context();
+    auto ret    = co_await coro::offload(
+        [val]()
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            return val;
+        });
+    // resumed on the context it came from
+    mtx.lock();
+    vec.push_back(&local_context() == origin ? ret : -1);
+    mtx.unlock();
+}
+
+task<> offload_sleep_func(std::atomic<bool>& started, std::vector<int>& vec)
+{
+    started = true;
+    co_await coro::offload([]() { std::this_thread::sleep_for(std::chrono::milliseconds(100)); });
+    // context is forced to stop before func returns, so this never runs
+    vec.push_back(1);
+}
+
+task<> offload_throw_func(std::vector<int>& vec, std::mutex& mtx)
+{
+    try
+    {
+        co_await coro::offload([]() -> int { throw std::runtime_error("offload error"); });
+    }
+    catch (const std::runtime_error& e)
+    {
+        mtx.lock();
+        vec.push_back(1);
+        mtx.unlock();
+    }
+}
+
+task<> switch_to_func(std::vector<int>& vec, int val, std::mutex& mtx)
+{
+    // visit every context in turn, each hop must land on the target context
+    bool ok = true;
+    for (size_t i = 0; i < scheduler::num_active_ctx(); i++)
+    {
+        auto id = scheduler::ctx_id_of((val + i) % scheduler::num_active_ctx());
+        co_await coro::switch_to(id);
+        ok = ok && local_context().get_ctx_id() == id;
+    }
+    co_await coro::switch_to_any();
+
+    mtx.lock();
+    vec.push_back(ok ? val : -1);
+    mtx.unlock();
+}
+
+task<> instance_func(scheduler& sc, std::vector<int>& vec, int val, int child, std::mutex& mtx)
+{
+    // tasks submitted by a working thread stay in the instance which owns it
+    if (child >= 0)
+    {
+        submit_to_scheduler(instance_func(sc, vec, child, -1, mtx));
+    }
+    mtx.lock();
+    vec.push_back(&scheduler::current() == &sc ? val : -1);
+    mtx.unlock();
+    co_return;
+}
+
+task<> cross_submit_func(scheduler& target, std::vector<int>& vec, std::atomic<bool>& done)
+{
+    // target is shut down, the task must be rejected instead of running in this instance
+    scheduler::submit(target, func(vec, 0));
+    done = true;
+    co_return;
+}
+
+task<> endless_yield_func(std::atomic<bool>& started)
+{
+    started = true;
+    while (true)
+    {
+        co_await coro::yield();
+    }
+}
+
+task<> endless_read_func(std::atomic<bool>& started, std::atomic<int>& result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        co_return;
+    }
+
+    // nothing is written to pipe, so the read only finishes by cancellation
+    int in  = -1;
+    started = true;
+    result  = co_await io::uring_op([&](io_uring_sqe* sqe) { io_uring_prep_read(sqe, fds[0], &in, sizeof(in), 0); });
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void DispatcherTest::add_load(size_t id, int num)
+{
+    for (int i = 0; i < num; i++)
+    {
+        m_tasks.push_back(func(m_vec, i));
+        m_ctxs[id]->submit_task(m_tasks.back().handle());
+    }
+}
+
 /*************************************************************
  *                          tests                            *
  *************************************************************/
@@ -162,6 +343,108 @@ TEST_F(ContextTest, SubmitMoveTask)
     handle.destroy();
 }
 
+TEST_F(ContextTest, KeepPriorityAfterIO)
+{
+    m_ctx.submit_task(prio_nop_func(m_vec), task_priority::high);
+    m_ctx.start();
+    m_ctx.join();
+
+    ASSERT_EQ(m_vec.size(), 1);
+    ASSERT_EQ(m_vec[0], 3);
+}
+
+TEST_F(ContextTest, RunTaskWithCpuAffinity)
+{
+    auto cpus = utils::get_allowed_cpus();
+    ASSERT_FALSE(cpus.empty());
+
+    std::mutex mtx;
+    m_ctx.set_cpu_affinity({cpus.back()});
+    m_ctx.submit_task(cpu_func(m_vec, mtx));
+    m_ctx.start();
+    m_ctx.join();
+
+    ASSERT_EQ(m_vec.size(), 1);
+    ASSERT_EQ(m_vec[0], cpus.back());
+}
+
+TEST_F(ContextTest, RetireMigrateTask)
+{
+    const int task_num = 1000;
+
+    std::vector<std::coroutine_handle<>> migrated;
+    m_ctx.set_migrate_cb([&](std::coroutine_handle<> handle, task_priority prio) { migrated.push_back(handle); });
+    for (int i = 0; i < task_num; i++)
+    {
+        m_ctx.submit_task(func(m_vec, i));
+    }
+
+    m_ctx.start();
+    m_ctx.retire();
+    m_ctx.join();
+
+    // each task either ran in context before retire or was migrated out
+    for (auto handle : migrated)
+    {
+        handle.resume();
+        clean(handle);
+    }
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+TEST_F(ContextTest, RetireRejectSubmit)
+{
+    const int task_num = 1000;
+
+    std::vector<std::coroutine_handle<>> migrated;
+    std::vector<std::coroutine_handle<>> rejected;
+    m_ctx.set_migrate_cb([&](std::coroutine_handle<> handle, task_priority prio) { migrated.push_back(handle); });
+    // context only stops by retire, like contexts of a long running scheduler
+    m_ctx.set_stop_cb([]() {});
+    m_ctx.start();
+
+    std::thread submitter(
+        [&]()
+        {
+            for (int i = 0; i < task_num; i++)
+            {
+                auto task   = func(m_vec, i);
+                auto handle = task.handle();
+                task.detach();
+                if (!m_ctx.try_submit_task(handle, task_priority::normal))
+                {
+                    rejected.push_back(handle);
+                }
+            }
+        });
+    m_ctx.retire();
+    submitter.join();
+    m_ctx.join();
+
+    // each task either ran in context, was migrated out or was rejected, none is lost
+    for (auto handle : migrated)
+    {
+        handle.resume();
+        clean(handle);
+    }
+    for (auto handle : rejected)
+    {
+        handle.resume();
+        clean(handle);
+    }
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
 TEST_P(ContextRunTaskTest, RunTask)
 {
     const int task_num = GetParam();
@@ -185,6 +468,28 @@ TEST_P(ContextRunTaskTest, RunTask)
 
 INSTANTIATE_TEST_SUITE_P(ContextRunTaskTests, ContextRunTaskTest, ::testing::Values(1, 10, 100, 10000));
 
+TEST_P(ContextRunTaskTest, RunBatchTask)
+{
+    const int task_num = GetParam();
+
+    std::vector<task<>> tasks;
+    for (int i = 0; i < task_num; i++)
+    {
+        tasks.push_back(func(m_vec, i));
+    }
+    m_ctx.submit_batch(tasks);
+
+    m_ctx.start();
+    m_ctx.join();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
 TEST_P(ContextMultiThreadAddTaskTest, MultiThreadAddTask)
 {
     const int thread_num = GetParam();
@@ -259,6 +564,28 @@ TEST_P(SchedulerRunTaskTest, RunTask)
 
 INSTANTIATE_TEST_SUITE_P(SchedulerRunTaskTests, SchedulerRunTaskTest, ::testing::Values(1, 10, 100, 10000));
 
+TEST_P(SchedulerRunTaskTest, RunBatchTask)
+{
+    const int task_num = GetParam();
+    scheduler::init();
+
+    std::vector<task<>> tasks;
+    for (int i = 0; i < task_num; i++)
+    {
+        tasks.push_back(mutex_func(m_vec, i, m_mtx));
+    }
+    scheduler::submit_batch(tasks);
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
 TEST_P(SchedulerSubmitTest, SubmitToScheduler)
 {
     const int task_num = GetParam();
@@ -299,3 +626,357 @@ TEST_P(SchedulerAddNopIOTest, AddNopIO)
 }
 
 INSTANTIATE_TEST_SUITE_P(SchedulerAddNopIOTests, SchedulerAddNopIOTest, ::testing::Values(1, 10, 100, 10000));
+
+TEST_F(SchedulerTest, RunTaskWithNumaAffinity)
+{
+    const int task_num = 100;
+    scheduler::init(0, detail::affinity_strategy::numa_node);
+
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(cpu_func(m_vec, m_mtx));
+    }
+
+    scheduler::loop();
+
+    auto cpus = utils::get_allowed_cpus();
+    ASSERT_EQ(m_vec.size(), task_num);
+    for (auto cpu : m_vec)
+    {
+        ASSERT_NE(std::find(cpus.begin(), cpus.end(), cpu), cpus.end());
+    }
+}
+
+TEST_F(SchedulerTest, DrainOnShutdown)
+{
+    const int task_num = 1000;
+    scheduler::init();
+    scheduler::start();
+
+    // contexts keep running without any task in long run mode
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(mutex_func_nop(m_vec, i, m_mtx));
+    }
+
+    auto report = scheduler::shutdown(std::chrono::seconds(10));
+
+    ASSERT_TRUE(report.drained);
+    ASSERT_EQ(report.num_cancelled_task, 0);
+    ASSERT_EQ(report.num_cancelled_io, 0);
+    ASSERT_EQ(report.num_rejected_task, 0);
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+TEST_F(SchedulerTest, CancelOnDeadline)
+{
+    std::atomic<bool> started{false};
+    scheduler::init();
+    scheduler::start();
+
+    submit_to_scheduler(endless_yield_func(started));
+    while (!started)
+    {
+        std::this_thread::yield();
+    }
+
+    auto report = scheduler::shutdown(std::chrono::milliseconds(10));
+
+    ASSERT_FALSE(report.drained);
+    ASSERT_EQ(report.num_cancelled_task, 1);
+    ASSERT_EQ(report.num_cancelled_io, 0);
+}
+
+TEST_F(SchedulerTest, CancelIoOnDeadline)
+{
+    std::atomic<bool> started{false};
+    std::atomic<int>  result{0};
+    scheduler::init();
+    scheduler::start();
+
+    submit_to_scheduler(endless_read_func(started, result));
+    while (!started)
+    {
+        std::this_thread::yield();
+    }
+
+    auto report = scheduler::shutdown(std::chrono::milliseconds(10));
+
+    ASSERT_FALSE(report.drained);
+    ASSERT_EQ(report.num_cancelled_task, 0);
+    ASSERT_EQ(report.num_cancelled_io, 1);
+    ASSERT_EQ(result, -ECANCELED);
+}
+
+TEST_F(SchedulerTest, ElasticScaling)
+{
+    const int task_num = 1000;
+    scheduler::init_elastic(1, 4);
+    scheduler::start();
+    ASSERT_EQ(scheduler::num_active_ctx(), 1);
+
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(sleep_func(m_vec, i, m_mtx));
+    }
+
+    // contexts are added when the only context is overloaded
+    size_t max_active = 1;
+    auto   deadline   = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (max_active == 1 && std::chrono::steady_clock::now() < deadline)
+    {
+        max_active = std::max(max_active, scheduler::num_active_ctx());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GT(max_active, 1);
+
+    // and retired after all tasks finish
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    while (scheduler::num_active_ctx() > 1 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(scheduler::num_active_ctx(), 1);
+
+    auto report = scheduler::shutdown(std::chrono::seconds(10));
+
+    ASSERT_TRUE(report.drained);
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+TEST_F(SchedulerTest, OffloadResumeOnOriginContext)
+{
+    const int task_num = 1000;
+    auto      start    = get_offload_stats();
+    scheduler::init();
+
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(offload_func(m_vec, i, m_mtx));
+    }
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+
+    auto stats = get_offload_stats();
+    ASSERT_EQ(stats.num_submit - start.num_submit, task_num);
+    ASSERT_EQ(stats.num_finish - start.num_finish, task_num);
+    ASSERT_EQ(stats.queue_depth, 0);
+    ASSERT_GT(stats.max_queue_depth, 0);
+}
+
+TEST_F(SchedulerTest, OffloadRethrowException)
+{
+    scheduler::init();
+
+    submit_to_scheduler(offload_throw_func(m_vec, m_mtx));
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), 1);
+}
+
+TEST_F(SchedulerTest, OffloadDropOnForcedStop)
+{
+    std::atomic<bool> started{false};
+    scheduler::init(1);
+    scheduler::start();
+
+    submit_to_scheduler(offload_sleep_func(started, m_vec));
+    while (!started)
+    {
+        std::this_thread::yield();
+    }
+
+    auto report = scheduler::shutdown(std::chrono::milliseconds(10));
+
+    ASSERT_FALSE(report.drained);
+    ASSERT_EQ(report.num_cancelled_task, 1);
+    ASSERT_EQ(report.num_cancelled_io, 0);
+
+    // func returns after context deinits, the coroutine is cleaned instead of resumed
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ASSERT_EQ(m_vec.size(), 0);
+}
+
+TEST_F(SchedulerTest, SwitchToHopAcrossContexts)
+{
+    const int task_num = 1000;
+    scheduler::init(4);
+
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(switch_to_func(m_vec, i, m_mtx));
+    }
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    std::sort(m_vec.begin(), m_vec.end());
+    for (int i = 0; i < task_num; i++)
+    {
+        ASSERT_EQ(m_vec[i], i);
+    }
+}
+
+TEST_F(SchedulerTest, StatsSnapshotAfterLoop)
+{
+    const int task_num = 1000;
+    scheduler::init(4);
+
+    for (int i = 0; i < task_num; i++)
+    {
+        submit_to_scheduler(mutex_func_nop(m_vec, i, m_mtx));
+    }
+
+    scheduler::loop();
+
+    ASSERT_EQ(m_vec.size(), task_num);
+    auto stats = scheduler::snapshot_stats();
+    ASSERT_EQ(stats.ctxs.size(), 4);
+
+    // each task is resumed once at start and once after its nop io finishes
+    ASSERT_EQ(stats.total.num_task_exec, 2 * task_num);
+    ASSERT_EQ(stats.total.num_cqe, task_num);
+    ASSERT_EQ(stats.total.num_io_running, 0);
+    ASSERT_EQ(stats.total.num_task_queued, 0);
+    ASSERT_GT(stats.total.max_task_queued, 0);
+
+    size_t num_task_exec = 0;
+    for (auto& cs : stats.ctxs)
+    {
+        num_task_exec += cs.num_task_exec;
+    }
+    ASSERT_EQ(num_task_exec, stats.total.num_task_exec);
+}
+
+TEST_F(SchedulerTest, IsolatedInstances)
+{
+    const int        task_num = 1000;
+    std::vector<int> vec[2];
+    scheduler        sc[2] = {scheduler(2), scheduler(2)};
+
+    std::vector<ctx_id> ids;
+    for (auto& s : sc)
+    {
+        ASSERT_EQ(scheduler::num_active_ctx(s), 2);
+        for (size_t i = 0; i < 2; i++)
+        {
+            ids.push_back(scheduler::ctx_id_of(s, i));
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ASSERT_EQ(std::unique(ids.begin(), ids.end()), ids.end());
+
+    for (int k = 0; k < 2; k++)
+    {
+        for (int i = 0; i < task_num; i++)
+        {
+            scheduler::submit(sc[k], instance_func(sc[k], vec[k], i, i + task_num, m_mtx));
+        }
+    }
+
+    std::thread loop_thread([&]() { scheduler::loop(sc[1]); });
+    scheduler::loop(sc[0]);
+    loop_thread.join();
+
+    for (int k = 0; k < 2; k++)
+    {
+        ASSERT_EQ(vec[k].size(), 2 * task_num);
+        std::sort(vec[k].begin(), vec[k].end());
+        for (int i = 0; i < 2 * task_num; i++)
+        {
+            ASSERT_EQ(vec[k][i], i);
+        }
+        ASSERT_EQ(scheduler::snapshot_stats(sc[k]).total.num_task_exec, 2 * task_num);
+    }
+}
+
+TEST_F(SchedulerTest, RejectFromOtherInstance)
+{
+    scheduler sc[2] = {scheduler(1), scheduler(1)};
+    scheduler::start(sc[0]);
+    scheduler::start(sc[1]);
+    scheduler::shutdown(sc[1], std::chrono::seconds(1));
+
+    std::atomic<bool> done{false};
+    scheduler::submit(sc[0], cross_submit_func(sc[1], m_vec, done));
+    while (!done)
+    {
+        std::this_thread::yield();
+    }
+    auto report = scheduler::shutdown(sc[0], std::chrono::seconds(1));
+
+    ASSERT_TRUE(report.drained);
+    ASSERT_TRUE(m_vec.empty());
+}
+
+TEST_F(DispatcherTest, LeastLoadedDispatch)
+{
+    detail::dispatcher<detail::dispatch_strategy::least_loaded> dispatcher;
+    dispatcher.init(m_ctxs.size(), &m_ctxs);
+
+    add_load(0, 3);
+    add_load(1, 1);
+    add_load(2, 2);
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(dispatcher.dispatch(), 3);
+    }
+
+    add_load(3, 5);
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(dispatcher.dispatch(), 1);
+    }
+}
+
+TEST_F(DispatcherTest, PowerOfTwoDispatch)
+{
+    detail::dispatcher<detail::dispatch_strategy::power_of_two> dispatcher;
+    dispatcher.init(m_ctxs.size(), &m_ctxs);
+
+    // two different contexts are compared, so the only loaded context is never chosen
+    add_load(0, 10);
+    for (int i = 0; i < 100; i++)
+    {
+        auto id = dispatcher.dispatch();
+        ASSERT_LT(id, m_ctxs.size());
+        ASSERT_NE(id, 0);
+    }
+}
+
+TEST_F(DispatcherTest, AffinityHashDispatch)
+{
+    detail::dispatcher<detail::dispatch_strategy::affinity_hash> dispatcher;
+    dispatcher.init(m_ctxs.size(), &m_ctxs);
+
+    std::vector<int> hit(m_ctxs.size(), 0);
+    for (uint64_t key = 0; key < 1000; key++)
+    {
+        auto id = dispatcher.dispatch(key);
+        ASSERT_EQ(dispatcher.dispatch(key), id);
+        hit[id]++;
+    }
+    for (auto num : hit)
+    {
+        ASSERT_GT(num, 0);
+    }
+}